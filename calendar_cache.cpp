@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+#include "calendar_cache.hpp"
+
+CalendarCache::CalendarCache(size_t budget) : budget(budget)
+{
+}
+
+ContributionCalendar *CalendarCache::get(const Key &key)
+{
+    auto it = find_entry(key);
+
+    if(it == entries.end() || !it->complete)
+    {
+        stats.misses++;
+        return nullptr;
+    }
+
+    stats.hits++;
+    entries.splice(entries.begin(), entries, it);
+
+    return &it->calendar;
+}
+
+ContributionCalendar *CalendarCache::find(const Key &key)
+{
+    auto it = find_entry(key);
+    return it == entries.end() ? nullptr : &it->calendar;
+}
+
+bool CalendarCache::contains(const Key &key) const
+{
+    auto it = find_entry(key);
+    return it != entries.end() && it->complete;
+}
+
+ContributionCalendar &CalendarCache::insert(const Key &key)
+{
+    auto it = find_entry(key);
+
+    if(it != entries.end())
+    {
+        // being refilled, so not usable until the next update
+        it->complete = false;
+        entries.splice(entries.begin(), entries, it);
+    }
+    else
+    {
+        entries.push_front({std::string(key.login), key.year, key.kind, ContributionCalendar(key.kind), 0, 0, false, false});
+
+        auto &entry = entries.front();
+        entry.bytes = entry_size(entry);
+        used += entry.bytes;
+    }
+
+    return entries.front().calendar;
+}
+
+void CalendarCache::update(const Key &key)
+{
+    auto it = find_entry(key);
+
+    if(it == entries.end())
+        return;
+
+    it->update_time = to_ms_since_boot(get_absolute_time());
+    it->complete = true;
+    it->stale = false;
+
+    fit_budget(it);
+}
+
+void CalendarCache::updateSize(const Key &key)
+{
+    auto it = find_entry(key);
+
+    if(it != entries.end())
+        fit_budget(it);
+}
+
+void CalendarCache::markStale(const Key &key)
+{
+    auto it = find_entry(key);
+
+    if(it != entries.end())
+        it->stale = true;
+}
+
+uint32_t CalendarCache::getAge(const Key &key) const
+{
+    auto it = find_entry(key);
+
+    if(it == entries.end() || !it->complete || it->stale)
+        return UINT32_MAX;
+
+    return to_ms_since_boot(get_absolute_time()) - it->update_time;
+}
+
+size_t CalendarCache::getUsedBytes() const
+{
+    return used;
+}
+
+const CalendarCache::Stats &CalendarCache::getStats() const
+{
+    return stats;
+}
+
+void CalendarCache::printStats() const
+{
+    printf("calendar cache: %i entries, %u/%u bytes, %u hits, %u misses, %u evictions\n",
+        entries.size(), used, budget, stats.hits, stats.misses, stats.evictions);
+}
+
+std::list<CalendarCache::Entry>::iterator CalendarCache::find_entry(const Key &key)
+{
+    return std::find_if(entries.begin(), entries.end(), [&key](const Entry &entry)
+    {
+        return entry.year == key.year && entry.kind == key.kind && entry.login == key.login;
+    });
+}
+
+std::list<CalendarCache::Entry>::const_iterator CalendarCache::find_entry(const Key &key) const
+{
+    return std::find_if(entries.begin(), entries.end(), [&key](const Entry &entry)
+    {
+        return entry.year == key.year && entry.kind == key.kind && entry.login == key.login;
+    });
+}
+
+size_t CalendarCache::entry_size(const Entry &entry)
+{
+    // including the list node and any heap allocated login
+    size_t login_bytes = entry.login.capacity() > 15 ? entry.login.capacity() + 1 : 0;
+    return sizeof(Entry) + sizeof(void *) * 2 + login_bytes + entry.calendar.getMemoryUsage() - sizeof(ContributionCalendar);
+}
+
+// never drops the one that was just changed
+void CalendarCache::fit_budget(std::list<Entry>::iterator keep)
+{
+    used -= keep->bytes;
+    keep->bytes = entry_size(*keep);
+    used += keep->bytes;
+
+    while(used > budget && entries.size() > 1)
+    {
+        auto victim = std::prev(entries.end());
+
+        if(victim == keep)
+            victim = std::prev(victim);
+
+        printf("calendar cache: evicting %s/%i\n", victim->login.c_str(), victim->year);
+
+        used -= victim->bytes;
+        entries.erase(victim);
+        stats.evictions++;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+
+#include "contribution_calendar.hpp"
+
+// recently fetched calendars, least recently used are dropped to stay within a byte budget
+class CalendarCache final
+{
+public:
+    struct Key
+    {
+        std::string_view login;
+        int year;
+        ContributionCalendar::Kind kind;
+    };
+
+    struct Stats
+    {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t evictions;
+    };
+
+    CalendarCache(size_t budget);
+
+    // counts as a hit/miss and marks the entry as most recently used, only returns complete entries
+    ContributionCalendar *get(const Key &key);
+
+    // no stats or reordering, also returns incomplete entries
+    ContributionCalendar *find(const Key &key);
+
+    // has a complete entry, no stats or reordering
+    bool contains(const Key &key) const;
+
+    // the existing entry or a new empty one, as the most recently used and incomplete
+    ContributionCalendar &insert(const Key &key);
+
+    // call after filling in or changing an entry, marks it complete, updates its size and time and evicts to fit the budget
+    void update(const Key &key);
+
+    // call after something that changes an entry's size but not its contents (like building its index), evicts to fit the budget
+    void updateSize(const Key &key);
+
+    // for entries loaded from somewhere that may be out of date, until the next update
+    void markStale(const Key &key);
+
+    // ms since the entry was updated, UINT32_MAX if it never was or it's marked stale
+    uint32_t getAge(const Key &key) const;
+
+    size_t getUsedBytes() const;
+    const Stats &getStats() const;
+    void printStats() const;
+
+private:
+    struct Entry
+    {
+        std::string login;
+        int year;
+        ContributionCalendar::Kind kind;
+
+        ContributionCalendar calendar;
+        size_t bytes;
+        uint32_t update_time;
+        bool complete;
+        bool stale;
+    };
+
+    std::list<Entry>::iterator find_entry(const Key &key);
+    std::list<Entry>::const_iterator find_entry(const Key &key) const;
+
+    static size_t entry_size(const Entry &entry);
+
+    void fit_budget(std::list<Entry>::iterator keep);
+
+    std::list<Entry> entries; // most recently used first
+
+    size_t budget;
+    size_t used = 0;
+
+    Stats stats = {};
+};
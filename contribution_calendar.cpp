@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cstring>
+
+#include "contribution_calendar.hpp"
+
+ContributionCalendar::ContributionCalendar(Kind kind) : kind(kind)
+{
+}
+
+void ContributionCalendar::reset(Kind kind)
+{
+    this->kind = kind;
+    num_weeks = 0;
+
+    // keep the capacity for the next fetch
+    levels.clear();
+    counts.clear();
+    index.clear();
+}
+
+ContributionCalendar::Kind ContributionCalendar::getKind() const
+{
+    return kind;
+}
+
+int ContributionCalendar::getNumWeeks() const
+{
+    return num_weeks;
+}
+
+void ContributionCalendar::setLevel(int week, int day, ContributionLevel level)
+{
+    if(kind != Kind::Level || day < 0 || day >= 7 || !grow(week))
+        return;
+
+    auto &word = levels[week];
+    int old_level = (word >> (day * level_bits)) & level_mask;
+    word = (word & ~(level_mask << (day * level_bits))) | uint32_t(level) << (day * level_bits);
+
+    update_index(week * 7 + day, old_level, int(level));
+}
+
+void ContributionCalendar::setCount(int week, int day, unsigned int count)
+{
+    if(kind != Kind::Count || day < 0 || day >= 7 || !grow(week))
+        return;
+
+    auto &value = counts[week * counts_per_week + day];
+    int old_count = value;
+    value = std::min(count, 0xFFFFu);
+
+    update_index(week * 7 + day, old_count, value);
+}
+
+ContributionLevel ContributionCalendar::getLevel(int week, int day) const
+{
+    if(week < 0 || week >= num_weeks || day < 0 || day >= 7 || kind != Kind::Level)
+        return ContributionLevel::None;
+
+    return ContributionLevel((levels[week] >> (day * level_bits)) & level_mask);
+}
+
+uint16_t ContributionCalendar::getCount(int week, int day) const
+{
+    if(week < 0 || week >= num_weeks || day < 0 || day >= 7 || kind != Kind::Count)
+        return 0;
+
+    return counts[week * counts_per_week + day];
+}
+
+uint32_t ContributionCalendar::getWeekLevels(int week) const
+{
+    if(week < 0 || week >= num_weeks || kind != Kind::Level)
+        return 0;
+
+    return levels[week];
+}
+
+void ContributionCalendar::alignFirstWeek(int num_days)
+{
+    if(num_weeks == 0 || num_days >= 7 || num_days <= 0)
+        return;
+
+    int offset = 7 - num_days;
+
+    if(kind == Kind::Level)
+        levels[0] <<= offset * level_bits;
+    else
+    {
+        auto week = counts.begin();
+        std::copy_backward(week, week + num_days, week + 7);
+        std::fill(week, week + offset, 0);
+    }
+
+    // everything moved
+    if(!index.empty())
+        buildIndex();
+}
+
+const uint16_t *ContributionCalendar::getCounts() const
+{
+    return counts.data();
+}
+
+size_t ContributionCalendar::getCountsLength() const
+{
+    return counts.size();
+}
+
+void ContributionCalendar::buildIndex()
+{
+    int num_days = num_weeks * 7;
+
+    index.resize(num_days + 1);
+    index[0] = 0;
+
+    for(int day = 0; day < num_days; day++)
+        index[day + 1] = index[day] + get_day_value(day);
+}
+
+bool ContributionCalendar::hasIndex() const
+{
+    return !index.empty();
+}
+
+uint32_t ContributionCalendar::getTotal(int first_day, int last_day) const
+{
+    first_day = std::max(first_day, 0);
+    last_day = std::min(last_day, num_weeks * 7 - 1);
+
+    if(first_day > last_day)
+        return 0;
+
+    if(!index.empty())
+        return index[last_day + 1] - index[first_day];
+
+    uint32_t total = 0;
+    for(int day = first_day; day <= last_day; day++)
+        total += get_day_value(day);
+
+    return total;
+}
+
+uint32_t ContributionCalendar::getWeekTotal(int week) const
+{
+    return getTotal(week * 7, week * 7 + 6);
+}
+
+size_t ContributionCalendar::getMemoryUsage() const
+{
+    return sizeof(*this) + levels.capacity() * sizeof(uint32_t) + counts.capacity() * sizeof(uint16_t) + index.capacity() * sizeof(uint32_t);
+}
+
+size_t ContributionCalendar::serialize(uint8_t *out) const
+{
+    out[0] = uint8_t(kind);
+    out[1] = num_weeks;
+
+    size_t len = kind == Kind::Level ? levels.size() * sizeof(uint32_t) : counts.size() * sizeof(uint16_t);
+    memcpy(out + 2, kind == Kind::Level ? static_cast<const void *>(levels.data()) : counts.data(), len);
+
+    return len + 2;
+}
+
+bool ContributionCalendar::deserialize(const uint8_t *data, size_t len)
+{
+    if(len < 2 || data[0] > uint8_t(Kind::Count) || data[1] > max_weeks)
+        return false;
+
+    auto new_kind = Kind(data[0]);
+    int new_weeks = data[1];
+
+    size_t data_len = new_kind == Kind::Level ? new_weeks * sizeof(uint32_t) : new_weeks * counts_per_week * sizeof(uint16_t);
+    if(len != data_len + 2)
+        return false;
+
+    reset(new_kind);
+
+    if(new_weeks && !grow(new_weeks - 1))
+        return false;
+
+    memcpy(kind == Kind::Level ? static_cast<void *>(levels.data()) : counts.data(), data + 2, data_len);
+
+    // 3 bits can hold more than the known levels, from corrupt (or older) data
+    if(kind == Kind::Level)
+    {
+        for(int week = 0; week < num_weeks; week++)
+        {
+            for(int day = 0; day < 7; day++)
+            {
+                if(getLevel(week, day) > ContributionLevel::FourthQuartile)
+                {
+                    reset(kind);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ContributionCalendar::grow(int week)
+{
+    if(week < 0 || week >= max_weeks)
+        return false;
+
+    if(week >= num_weeks)
+    {
+        num_weeks = week + 1;
+
+        if(kind == Kind::Level)
+            levels.resize(num_weeks);
+        else
+            counts.resize(num_weeks * counts_per_week);
+
+        // new days are empty
+        if(!index.empty())
+            index.resize(num_weeks * 7 + 1, index.back());
+    }
+
+    return true;
+}
+
+unsigned int ContributionCalendar::get_day_value(int day) const
+{
+    return kind == Kind::Count ? getCount(day / 7, day % 7) : unsigned(getLevel(day / 7, day % 7));
+}
+
+// only the days after this one change
+void ContributionCalendar::update_index(int day, int old_value, int new_value)
+{
+    if(index.empty() || old_value == new_value)
+        return;
+
+    int32_t delta = new_value - old_value;
+
+    for(size_t i = day + 1; i < index.size(); i++)
+        index[i] += delta;
+}
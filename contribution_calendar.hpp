@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "contribution_level.hpp"
+
+// a year (or any range) of contribution days, stored week-major as they're displayed
+// levels are packed 3 bits per day into one word per week, counts are 16 bits per day (saturating)
+class ContributionCalendar final
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Level,
+        Count
+    };
+
+    static constexpr int max_weeks = 54;
+
+    ContributionCalendar(Kind kind = Kind::Level);
+
+    void reset(Kind kind);
+
+    Kind getKind() const;
+
+    int getNumWeeks() const;
+
+    // week/day past the end grow the calendar, anything beyond max_weeks is ignored
+    void setLevel(int week, int day, ContributionLevel level);
+    void setCount(int week, int day, unsigned int count);
+
+    // days never set are None/0
+    ContributionLevel getLevel(int week, int day) const;
+    uint16_t getCount(int week, int day) const;
+
+    // whole week of levels, day n in bits 3n-3n+2
+    uint32_t getWeekLevels(int week) const;
+
+    // the first week is filled from day 0, but is usually partial and should end on the last day instead
+    void alignFirstWeek(int num_days);
+
+    // all counts, with zeros for unused days, 8 per week
+    const uint16_t *getCounts() const;
+    size_t getCountsLength() const;
+
+    size_t getMemoryUsage() const;
+
+    // prefix sums of the day values (counts, or levels) so any range total is O(1)
+    // built on first use, then kept up to date as days are set (which only touches the days after)
+    void buildIndex();
+    bool hasIndex() const;
+
+    // days are numbered week * 7 + day from the start of the first week, last is inclusive and both are clamped
+    // sums the days without an index
+    uint32_t getTotal(int first_day, int last_day) const;
+    uint32_t getWeekTotal(int week) const;
+
+    // for storing, the kind and number of weeks followed by the packed levels/counts
+    static constexpr size_t max_serialized_size = 2 + max_weeks * 8 * sizeof(uint16_t);
+
+    size_t serialize(uint8_t *out) const;
+    bool deserialize(const uint8_t *data, size_t len);
+
+private:
+    static constexpr int level_bits = 3;
+    static constexpr uint32_t level_mask = (1 << level_bits) - 1;
+    static constexpr int counts_per_week = 8; // padded for alignment
+
+    static_assert(int(ContributionLevel::Count) <= level_mask + 1);
+
+    bool grow(int week);
+
+    unsigned int get_day_value(int day) const;
+    void update_index(int day, int old_value, int new_value);
+
+    Kind kind;
+    int num_weeks = 0;
+
+    std::vector<uint32_t> levels;
+    std::vector<uint16_t> counts;
+
+    // total of the days before each day, num_weeks * 7 + 1 long (empty if not built)
+    std::vector<uint32_t> index;
+};
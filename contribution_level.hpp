@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+enum class ContributionLevel : uint8_t
+{
+    None = 0,
+    FirstQuartile,
+    SecondQuartile,
+    ThirdQuartile,
+    FourthQuartile,
+
+    Count
+};
+
+// NONE, FIRST_QUARTILE, SECOND_QUARTILE, THIRD_QUARTILE, FOURTH_QUARTILE all have a different third character
+constexpr ContributionLevel contribution_level_from_string(std::string_view str)
+{
+    if(str.length() < 3)
+        return ContributionLevel::None;
+
+    switch(str[2])
+    {
+        case 'R':
+            return ContributionLevel::FirstQuartile;
+        case 'C':
+            return ContributionLevel::SecondQuartile;
+        case 'I':
+            return ContributionLevel::ThirdQuartile;
+        case 'U':
+            return ContributionLevel::FourthQuartile;
+    }
+
+    return ContributionLevel::None;
+}
+
+static_assert(contribution_level_from_string("NONE") == ContributionLevel::None);
+static_assert(contribution_level_from_string("FIRST_QUARTILE") == ContributionLevel::FirstQuartile);
+static_assert(contribution_level_from_string("SECOND_QUARTILE") == ContributionLevel::SecondQuartile);
+static_assert(contribution_level_from_string("THIRD_QUARTILE") == ContributionLevel::ThirdQuartile);
+static_assert(contribution_level_from_string("FOURTH_QUARTILE") == ContributionLevel::FourthQuartile);
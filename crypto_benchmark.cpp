@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "mbedtls/cipher.h"
+#include "mbedtls/ecdh.h"
+#include "mbedtls/md.h"
+#include "mbedtls/ssl.h"
+
+// measures everything enabled in mbedtls_config.h so we can pick a preference order for TLSConfig
+
+static constexpr unsigned int record_size = 1024;
+static constexpr int cipher_iterations = 64;
+static constexpr int ecdh_iterations = 4;
+
+static uint8_t key[32] = {};
+static uint8_t iv[16] = {};
+static uint8_t additional_data[13] = {};
+
+static uint8_t input[record_size];
+static uint8_t output[record_size + 16];
+
+struct CipherResult
+{
+    mbedtls_cipher_type_t cipher;
+    mbedtls_md_type_t mac;
+    bool short_tag;
+    float cycles_per_byte;
+};
+
+struct SuiteResult
+{
+    int id;
+    float cycles_per_byte;
+};
+
+struct CurveResult
+{
+    mbedtls_ecp_group_id id;
+    float ms_per_exchange;
+};
+
+// not remotely secure, but fast and repeatable
+static int bench_rand(void *, unsigned char *output, size_t len)
+{
+    static uint32_t state = 0x12345678;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        output[i] = state;
+    }
+
+    return 0;
+}
+
+static float us_to_cycles(uint64_t us)
+{
+    return float(us) * (clock_get_hz(clk_sys) / 1000000);
+}
+
+static float bench_cipher(mbedtls_cipher_type_t type, mbedtls_md_type_t mac, bool short_tag)
+{
+    auto info = mbedtls_cipher_info_from_type(type);
+    if(!info)
+        return -1.0f;
+
+    mbedtls_cipher_context_t ctx;
+    mbedtls_cipher_init(&ctx);
+
+    if(mbedtls_cipher_setup(&ctx, info) != 0)
+    {
+        mbedtls_cipher_free(&ctx);
+        return -1.0f;
+    }
+
+    mbedtls_cipher_setkey(&ctx, key, mbedtls_cipher_get_key_bitlen(&ctx), MBEDTLS_ENCRYPT);
+
+    auto mode = mbedtls_cipher_get_cipher_mode(&ctx);
+    bool aead = mode == MBEDTLS_MODE_GCM || mode == MBEDTLS_MODE_CCM || mode == MBEDTLS_MODE_CHACHAPOLY;
+
+    auto md_info = mbedtls_md_info_from_type(mac);
+    uint8_t mac_out[64];
+
+    int ret = 0;
+    size_t olen;
+
+    auto start = time_us_64();
+
+    for(int i = 0; i < cipher_iterations && ret == 0; i++)
+    {
+        if(aead)
+        {
+            ret = mbedtls_cipher_auth_encrypt_ext(&ctx, iv, 12, additional_data, sizeof(additional_data),
+                                                  input, record_size, output, sizeof(output), &olen, short_tag ? 8 : 16);
+        }
+        else
+        {
+            ret = mbedtls_cipher_crypt(&ctx, iv, mbedtls_cipher_get_iv_size(&ctx), input, record_size, output, &olen);
+
+            if(ret == 0 && md_info)
+                ret = mbedtls_md_hmac(md_info, key, sizeof(key), output, olen, mac_out);
+        }
+    }
+
+    auto time = time_us_64() - start;
+
+    mbedtls_cipher_free(&ctx);
+
+    if(ret != 0)
+        return -1.0f;
+
+    return us_to_cycles(time) / (record_size * cipher_iterations);
+}
+
+static float bench_ecdh(mbedtls_ecp_group_id id)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d, z, peer_d;
+    mbedtls_ecp_point q, peer_q;
+
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_mpi_init(&d);
+    mbedtls_mpi_init(&z);
+    mbedtls_mpi_init(&peer_d);
+    mbedtls_ecp_point_init(&q);
+    mbedtls_ecp_point_init(&peer_q);
+
+    // the server's half isn't part of the measurement
+    int ret = mbedtls_ecp_group_load(&grp, id);
+    if(ret == 0)
+        ret = mbedtls_ecdh_gen_public(&grp, &peer_d, &peer_q, bench_rand, nullptr);
+
+    auto start = time_us_64();
+
+    for(int i = 0; i < ecdh_iterations && ret == 0; i++)
+    {
+        ret = mbedtls_ecdh_gen_public(&grp, &d, &q, bench_rand, nullptr);
+
+        if(ret == 0)
+            ret = mbedtls_ecdh_compute_shared(&grp, &z, &peer_q, &d, bench_rand, nullptr);
+    }
+
+    auto time = time_us_64() - start;
+
+    mbedtls_ecp_point_free(&peer_q);
+    mbedtls_ecp_point_free(&q);
+    mbedtls_mpi_free(&peer_d);
+    mbedtls_mpi_free(&z);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&grp);
+
+    if(ret != 0)
+        return -1.0f;
+
+    return float(time) / (ecdh_iterations * 1000);
+}
+
+int main()
+{
+    stdio_init_all();
+
+    while(!stdio_usb_connected())
+        sleep_ms(100);
+
+    printf("clk_sys %u Hz\n", clock_get_hz(clk_sys));
+
+    // record ciphers, most suites share one so only measure each combination once
+    std::vector<CipherResult> ciphers;
+    std::vector<SuiteResult> suites;
+
+    printf("\nRecord ciphers (%u byte records):\n", record_size);
+
+    for(auto id = mbedtls_ssl_list_ciphersuites(); *id; id++)
+    {
+        auto suite = mbedtls_ssl_ciphersuite_from_id(*id);
+        if(!suite)
+            continue;
+
+        auto cipher = mbedtls_cipher_type_t(suite->cipher);
+        auto mac = mbedtls_md_type_t(suite->mac);
+        bool short_tag = suite->flags & MBEDTLS_CIPHERSUITE_SHORT_TAG;
+
+        auto it = std::find_if(ciphers.begin(), ciphers.end(), [=](const CipherResult &res)
+        {
+            return res.cipher == cipher && res.mac == mac && res.short_tag == short_tag;
+        });
+
+        if(it == ciphers.end())
+        {
+            auto cycles = bench_cipher(cipher, mac, short_tag);
+            ciphers.push_back({cipher, mac, short_tag, cycles});
+            it = ciphers.end() - 1;
+        }
+
+        suites.push_back({*id, it->cycles_per_byte});
+
+        if(it->cycles_per_byte < 0.0f)
+            printf("%s: failed\n", suite->name);
+        else
+            printf("%s: %.1f cycles/byte\n", suite->name, it->cycles_per_byte);
+    }
+
+    // key exchange
+    std::vector<CurveResult> curves;
+
+    printf("\nKey exchange (ECDH, client side):\n");
+
+    for(auto id = mbedtls_ecp_grp_id_list(); *id != MBEDTLS_ECP_DP_NONE; id++)
+    {
+        auto ms = bench_ecdh(*id);
+        curves.push_back({*id, ms});
+
+        auto info = mbedtls_ecp_curve_info_from_grp_id(*id);
+        if(ms < 0.0f)
+            printf("%s: failed\n", info ? info->name : "?");
+        else
+            printf("%s: %.1f ms\n", info ? info->name : "?", ms);
+    }
+
+    // suggested order, fastest first
+    std::stable_sort(suites.begin(), suites.end(), [](const SuiteResult &a, const SuiteResult &b)
+    {
+        return a.cycles_per_byte >= 0.0f && (b.cycles_per_byte < 0.0f || a.cycles_per_byte < b.cycles_per_byte);
+    });
+
+    std::stable_sort(curves.begin(), curves.end(), [](const CurveResult &a, const CurveResult &b)
+    {
+        return a.ms_per_exchange >= 0.0f && (b.ms_per_exchange < 0.0f || a.ms_per_exchange < b.ms_per_exchange);
+    });
+
+    printf("\ntls_config.setCipherSuites({\n");
+    for(auto &suite : suites)
+        printf("    0x%04X, // %s\n", suite.id, mbedtls_ssl_get_ciphersuite_name(suite.id));
+    printf("});\n");
+
+    printf("\ntls_config.setCurves({\n");
+    for(auto &curve : curves)
+    {
+        auto info = mbedtls_ecp_curve_info_from_grp_id(curve.id);
+        printf("    mbedtls_ecp_group_id(%i), // %s\n", curve.id, info ? info->name : "?");
+    }
+    printf("});\n");
+
+    while(true)
+        sleep_ms(1000);
+
+    return 0;
+}
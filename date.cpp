@@ -0,0 +1,142 @@
+#include <charconv>
+
+#include "date.hpp"
+
+// from Howard Hinnant's civil calendar algorithms
+int days_from_date(const Date &date)
+{
+    int y = date.year - (date.month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+Date date_from_days(int days)
+{
+    days += 719468;
+
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int doe = days - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+
+    Date ret;
+    ret.day = doy - (153 * mp + 2) / 5 + 1;
+    ret.month = mp < 10 ? mp + 3 : mp - 9;
+    ret.year = yoe + era * 400 + (ret.month <= 2);
+
+    return ret;
+}
+
+int day_of_week(const Date &date)
+{
+    // 1970-01-01 was a Thursday
+    int days = days_from_date(date);
+    return days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6;
+}
+
+int day_of_year(const Date &date)
+{
+    return days_from_date(date) - days_from_date({date.year, 1, 1});
+}
+
+static bool parse_int(std::string_view str, int &value)
+{
+    auto res = std::from_chars(str.data(), str.data() + str.length(), value);
+    return res.ec == std::errc() && res.ptr == str.data() + str.length();
+}
+
+bool parse_http_date(std::string_view str, Date &date)
+{
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    // 0    5  8   12
+    if(str.length() < 16 || str[3] != ',')
+        return false;
+
+    auto month = std::string_view(months).find(str.substr(8, 3));
+    if(month == std::string_view::npos || month % 3)
+        return false;
+
+    date.month = month / 3 + 1;
+
+    return parse_int(str.substr(5, 2), date.day) && parse_int(str.substr(12, 4), date.year);
+}
+
+bool parse_iso_date(std::string_view str, Date &date)
+{
+    if(str.length() < 10 || str[4] != '-' || str[7] != '-')
+        return false;
+
+    return parse_int(str.substr(0, 4), date.year) && parse_int(str.substr(5, 2), date.month) && parse_int(str.substr(8, 2), date.day);
+}
+
+// "HH:MM:SS"
+static bool parse_time_of_day(std::string_view str, int &seconds)
+{
+    int h, m, s;
+
+    if(str.length() < 8 || str[2] != ':' || str[5] != ':')
+        return false;
+
+    if(!parse_int(str.substr(0, 2), h) || !parse_int(str.substr(3, 2), m) || !parse_int(str.substr(6, 2), s))
+        return false;
+
+    seconds = h * 3600 + m * 60 + s;
+    return true;
+}
+
+bool parse_http_time(std::string_view str, uint32_t &time)
+{
+    Date date;
+    int seconds;
+
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    //                  17
+    if(!parse_http_date(str, date) || str.length() < 25 || !parse_time_of_day(str.substr(17, 8), seconds))
+        return false;
+
+    time = uint32_t(days_from_date(date)) * 86400 + seconds;
+    return true;
+}
+
+bool parse_iso_time(std::string_view str, uint32_t &time)
+{
+    Date date;
+    int seconds;
+
+    // 1994-11-06T08:49:37Z
+    if(!parse_iso_date(str, date) || str.length() < 19 || str[10] != 'T' || !parse_time_of_day(str.substr(11, 8), seconds))
+        return false;
+
+    time = uint32_t(days_from_date(date)) * 86400 + seconds;
+    return true;
+}
+
+size_t format_iso_date(char *out, const Date &date)
+{
+    int values[]{date.year, date.month, date.day};
+    int digits[]{4, 2, 2};
+    char *p = out;
+
+    for(int i = 0; i < 3; i++)
+    {
+        if(i)
+            *p++ = '-';
+
+        int value = values[i];
+        for(int j = digits[i] - 1; j >= 0; j--)
+        {
+            p[j] = '0' + value % 10;
+            value /= 10;
+        }
+        p += digits[i];
+    }
+
+    return p - out;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// just enough calendar maths to place days in the contribution calendar
+
+struct Date
+{
+    int year, month, day; // month and day from 1
+};
+
+// days since 1970-01-01
+int days_from_date(const Date &date);
+Date date_from_days(int days);
+
+// 0 = Sunday, the first row of the calendar
+int day_of_week(const Date &date);
+
+// 0 = January 1st
+int day_of_year(const Date &date);
+
+// from an HTTP Date header ("Sun, 06 Nov 1994 08:49:37 GMT")
+bool parse_http_date(std::string_view str, Date &date);
+
+// from "YYYY-MM-DD" (also accepts a trailing time)
+bool parse_iso_date(std::string_view str, Date &date);
+
+// seconds since 1970 (UTC) from an HTTP Date header or "YYYY-MM-DDTHH:MM:SSZ"
+bool parse_http_time(std::string_view str, uint32_t &time);
+bool parse_iso_time(std::string_view str, uint32_t &time);
+
+// writes "YYYY-MM-DD", returns the length (10)
+size_t format_iso_date(char *out, const Date &date);
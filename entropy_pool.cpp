@@ -0,0 +1,227 @@
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+#include "entropy_pool.hpp"
+
+#if PICO_ON_DEVICE
+#include "lwip/arch.h"
+
+static uint32_t entropy_source()
+{
+    return pico_lwip_rand();
+}
+
+// the pool is shared by the refill timer and mbedtls, only the indices/health test state are guarded
+// the (slow) source reads happen with interrupts enabled
+static uint32_t lock()
+{
+    return save_and_disable_interrupts();
+}
+
+static void unlock(uint32_t irq)
+{
+    restore_interrupts(irq);
+}
+#else
+#include <random>
+
+static uint32_t entropy_source()
+{
+    static std::random_device device;
+    return device();
+}
+
+static uint32_t lock()
+{
+    return 0;
+}
+
+static void unlock(uint32_t)
+{
+}
+#endif
+
+static constexpr unsigned int max_health_retries = 16;
+
+EntropyPool::EntropyPool(SourceFunc source) : source(source){}
+
+bool EntropyPool::refill(unsigned int max_words)
+{
+    if(count + 4 > pool_size)
+        return false;
+
+    for(unsigned int i = 0; i < max_words; i++)
+    {
+        uint32_t word;
+        if(!next_word(word))
+            break;
+
+        // a read may have happened while collecting, or another refill filled it
+        auto irq = lock();
+
+        bool full = count + 4 > pool_size;
+
+        if(!full)
+        {
+            for(int b = 0; b < 4; b++, word >>= 8)
+                pool[(read_pos + count++) % pool_size] = word;
+        }
+
+        unlock(irq);
+
+        if(full)
+            break;
+    }
+
+    return true;
+}
+
+size_t EntropyPool::read(uint8_t *out, size_t len)
+{
+    size_t done = 0;
+
+    auto irq = lock();
+
+    // from the pool
+    for(; done < len && count; done++, count--)
+    {
+        out[done] = pool[read_pos];
+        read_pos = (read_pos + 1) % pool_size;
+    }
+
+    if(done < len)
+        stats.underruns++;
+
+    unlock(irq);
+
+    // straight from the source if it ran out, only using as many bytes as needed
+    while(done < len)
+    {
+        uint32_t word;
+        if(!next_word(word))
+            break;
+
+        for(int b = 0; b < 4 && done < len; b++, word >>= 8)
+            out[done++] = word;
+    }
+
+    irq = lock();
+    stats.bytes_served += done;
+    unlock(irq);
+
+    return done;
+}
+
+size_t EntropyPool::available() const
+{
+    return count;
+}
+
+const EntropyPool::Stats &EntropyPool::getStats() const
+{
+    return stats;
+}
+
+bool EntropyPool::next_word(uint32_t &word)
+{
+    for(unsigned int i = 0; i < max_health_retries; i++)
+    {
+        word = source();
+
+        auto irq = lock();
+        stats.words_collected++;
+        bool ok = health_test(word);
+        unlock(irq);
+
+        if(ok)
+            return true;
+    }
+
+    return false;
+}
+
+bool EntropyPool::health_test(uint32_t word)
+{
+    bool ok = true;
+
+    // repetition count
+    if(word == last_word && stats.words_collected > 1)
+    {
+        if(++repetition_count >= repetition_cutoff - 1)
+        {
+            stats.repetition_failures++;
+            ok = false;
+        }
+    }
+    else
+        repetition_count = 0;
+
+    last_word = word;
+
+    // adaptive proportion, over bytes
+    for(int b = 0; b < 4; b++, word >>= 8)
+    {
+        uint8_t sample = word;
+
+        if(proportion_samples == 0)
+        {
+            proportion_sample = sample;
+            proportion_count = 1;
+        }
+        else if(sample == proportion_sample && ++proportion_count == proportion_cutoff)
+        {
+            stats.proportion_failures++;
+            ok = false;
+        }
+
+        if(++proportion_samples == proportion_window)
+            proportion_samples = 0;
+    }
+
+    return ok;
+}
+
+// global pool for mbedtls
+static EntropyPool pool(entropy_source);
+
+#if PICO_ON_DEVICE
+static repeating_timer_t refill_timer;
+
+static bool refill_callback(repeating_timer_t *)
+{
+    // a few words at a time to keep the interrupt short
+    pool.refill(4);
+
+    return true;
+}
+#endif
+
+void entropy_init()
+{
+    pool.refill(~0u);
+
+#if PICO_ON_DEVICE
+    add_repeating_timer_ms(10, refill_callback, nullptr, &refill_timer);
+#endif
+}
+
+void entropy_print_stats()
+{
+    auto &stats = pool.getStats();
+    printf("Entropy: %u served, %u collected, %zu available, %u underruns, %u repetition failures, %u proportion failures\n",
+        stats.bytes_served, stats.words_collected, pool.available(), stats.underruns,
+        stats.repetition_failures, stats.proportion_failures);
+}
+
+extern "C"
+int mbedtls_hardware_poll(void *, unsigned char *output, size_t len, size_t *olen)
+{
+    *olen = pool.read(output, len);
+
+#if !PICO_ON_DEVICE
+    pool.refill(~0u);
+#endif
+
+    return 0;
+}
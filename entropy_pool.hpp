@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// buffers raw entropy ahead of time so mbedtls doesn't have to wait for the source mid-handshake
+// refill can run from an interrupt while read is used elsewhere, the source is only read with interrupts enabled
+class EntropyPool final
+{
+public:
+    using SourceFunc = uint32_t (*)();
+
+    struct Stats
+    {
+        uint32_t bytes_served;
+        uint32_t words_collected;
+        uint32_t underruns; // reads that had to go to the source directly
+        uint32_t repetition_failures;
+        uint32_t proportion_failures;
+    };
+
+    EntropyPool(SourceFunc source);
+
+    // adds up to max_words from the source, returns false if already full
+    bool refill(unsigned int max_words);
+
+    // always fills len bytes unless the source keeps failing health tests
+    size_t read(uint8_t *out, size_t len);
+
+    size_t available() const;
+
+    const Stats &getStats() const;
+
+private:
+    static constexpr size_t pool_size = 256;
+
+    // SP 800-90B style tests, assuming at least 4 bits of entropy per byte
+    static constexpr unsigned int repetition_cutoff = 3; // identical words in a row
+    static constexpr unsigned int proportion_window = 512;
+    static constexpr unsigned int proportion_cutoff = 62;
+
+    bool next_word(uint32_t &word);
+    bool health_test(uint32_t word);
+
+    SourceFunc source;
+
+    uint8_t pool[pool_size];
+    size_t read_pos = 0, count = 0;
+
+    uint32_t last_word = 0;
+    unsigned int repetition_count = 0;
+
+    uint8_t proportion_sample = 0;
+    unsigned int proportion_count = 0, proportion_samples = 0;
+
+    Stats stats = {};
+};
+
+// starts background refilling of the global pool used by mbedtls_hardware_poll
+void entropy_init();
+
+void entropy_print_stats();
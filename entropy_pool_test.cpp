@@ -0,0 +1,133 @@
+#include <cstdio>
+
+#include "entropy_pool.hpp"
+
+// host test for EntropyPool (PICO_PLATFORM=host), exact-length reads and the health test counters
+
+// not assert, so it still checks in release builds
+#define CHECK(cond) \
+    if(!(cond)) \
+    { \
+        printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return false; \
+    }
+
+static uint32_t xorshift_state = 0x12345678;
+
+// passes the health tests
+static uint32_t xorshift_source()
+{
+    xorshift_state ^= xorshift_state << 13;
+    xorshift_state ^= xorshift_state >> 17;
+    xorshift_state ^= xorshift_state << 5;
+    return xorshift_state;
+}
+
+// stuck source, fails both tests
+static uint32_t constant_source()
+{
+    return 0x5A5A5A5A;
+}
+
+// different words, but mostly zero bytes
+static uint32_t sparse_source()
+{
+    static uint32_t counter = 0;
+    return ++counter << 8;
+}
+
+static bool test_exact_reads()
+{
+    EntropyPool pool(xorshift_source);
+    uint8_t buf[600];
+
+    pool.refill(~0u);
+    size_t full = pool.available();
+    CHECK(full > 0 && full % 4 == 0);
+
+    bool refilled = pool.refill(~0u);
+    CHECK(!refilled);
+
+    // from the pool
+    size_t len = pool.read(buf, 3);
+    CHECK(len == 3);
+    CHECK(pool.available() == full - 3);
+    CHECK(pool.getStats().underruns == 0);
+
+    // the rest of the pool, then a partial word from the source
+    len = pool.read(buf, sizeof(buf));
+    CHECK(len == sizeof(buf));
+    CHECK(pool.available() == 0);
+    CHECK(pool.getStats().underruns == 1);
+
+    // every length up to more than the pool holds
+    for(size_t want = 1; want <= sizeof(buf); want++)
+    {
+        pool.refill(want % 7);
+        len = pool.read(buf, want);
+        CHECK(len == want);
+    }
+
+    auto &stats = pool.getStats();
+    CHECK(stats.bytes_served == 3 + sizeof(buf) + sizeof(buf) * (sizeof(buf) + 1) / 2);
+    CHECK(stats.repetition_failures == 0 && stats.proportion_failures == 0);
+
+    return true;
+}
+
+static bool test_stuck_source()
+{
+    EntropyPool pool(constant_source);
+    uint8_t buf[16];
+
+    // two words pass before the repetition test trips, then every retry fails
+    size_t len = pool.read(buf, sizeof(buf));
+    CHECK(len == 8);
+
+    auto &stats = pool.getStats();
+    CHECK(stats.underruns == 1);
+    CHECK(stats.bytes_served == 8);
+    CHECK(stats.words_collected == 18);
+    CHECK(stats.repetition_failures == 16);
+    CHECK(stats.proportion_failures == 1); // the 62nd identical byte
+
+    // nothing added while failing
+    bool refilled = pool.refill(4);
+    CHECK(refilled);
+    CHECK(pool.available() == 0);
+
+    return true;
+}
+
+static bool test_biased_source()
+{
+    EntropyPool pool(sparse_source);
+
+    // 3 of each 4 bytes are 0, so the 62nd 0 is in the 21st word
+    pool.refill(20);
+    CHECK(pool.available() == 80);
+    CHECK(pool.getStats().proportion_failures == 0);
+
+    // that one's dropped and the retry passes
+    pool.refill(1);
+    CHECK(pool.available() == 84);
+
+    auto &stats = pool.getStats();
+    CHECK(stats.proportion_failures == 1);
+    CHECK(stats.repetition_failures == 0);
+    CHECK(stats.words_collected == 22);
+
+    return true;
+}
+
+int main()
+{
+    if(!test_exact_reads() || !test_stuck_source() || !test_biased_source())
+    {
+        printf("entropy pool tests failed\n");
+        return 1;
+    }
+
+    printf("entropy pool tests passed\n");
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "pico/stdlib.h"
+
+#include "flash_region.hpp"
+
+#if PICO_ON_DEVICE
+#include "hardware/flash.h"
+
+static_assert(FlashRegion::sector_size == FLASH_SECTOR_SIZE);
+#else
+// the whole region, created full of 0xFF if it doesn't exist
+#ifndef FLASH_REGION_FILE
+#define FLASH_REGION_FILE "flash_region.bin"
+#endif
+#endif
+
+FlashRegion::FlashRegion(uint32_t offset, int num_sectors) : offset(offset), num_sectors(num_sectors)
+{
+}
+
+bool FlashRegion::init()
+{
+#if PICO_ON_DEVICE
+    return offset % sector_size == 0 && offset + num_sectors * sector_size <= PICO_FLASH_SIZE_BYTES;
+#else
+    if(file)
+        return true;
+
+    auto f = fopen(FLASH_REGION_FILE, "r+b");
+
+    if(!f)
+    {
+        f = fopen(FLASH_REGION_FILE, "w+b");
+        if(!f)
+            return false;
+
+        uint8_t erased[sector_size];
+        memset(erased, 0xFF, sector_size);
+
+        for(int i = 0; i < num_sectors; i++)
+            fwrite(erased, 1, sector_size, f);
+    }
+
+    file = f;
+    return true;
+#endif
+}
+
+int FlashRegion::getNumSectors() const
+{
+    return num_sectors;
+}
+
+bool FlashRegion::read(uint32_t addr, void *data, size_t len) const
+{
+    if(!in_range(addr, len))
+        return false;
+
+#if PICO_ON_DEVICE
+    // memory mapped
+    memcpy(data, reinterpret_cast<const uint8_t *>(XIP_BASE + offset + addr), len);
+    return true;
+#else
+    auto f = static_cast<FILE *>(file);
+    return f && fseek(f, addr, SEEK_SET) == 0 && fread(data, 1, len, f) == len;
+#endif
+}
+
+bool FlashRegion::program(uint32_t addr, const void *data, size_t len)
+{
+    if(!in_range(addr, len))
+        return false;
+
+    auto in = static_cast<const uint8_t *>(data);
+
+#if PICO_ON_DEVICE
+    // whole pages, padded with 0xFF which leaves the existing contents alone
+    static uint8_t page[FLASH_PAGE_SIZE];
+
+    while(len)
+    {
+        uint32_t page_addr = addr & ~(FLASH_PAGE_SIZE - 1);
+        size_t page_off = addr - page_addr;
+        size_t chunk = std::min(len, size_t(FLASH_PAGE_SIZE) - page_off);
+
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page + page_off, in, chunk);
+
+        // nothing can run from flash while it's being written, including the wifi/lwip interrupts
+        auto irq = save_and_disable_interrupts();
+        flash_range_program(offset + page_addr, page, FLASH_PAGE_SIZE);
+        restore_interrupts(irq);
+
+        addr += chunk;
+        in += chunk;
+        len -= chunk;
+    }
+
+    return true;
+#else
+    uint8_t buf[256];
+
+    while(len)
+    {
+        size_t chunk = std::min(len, sizeof(buf));
+
+        if(!read(addr, buf, chunk))
+            return false;
+
+        for(size_t i = 0; i < chunk; i++)
+            buf[i] &= in[i];
+
+        auto f = static_cast<FILE *>(file);
+        if(fseek(f, addr, SEEK_SET) != 0 || fwrite(buf, 1, chunk, f) != chunk)
+            return false;
+
+        addr += chunk;
+        in += chunk;
+        len -= chunk;
+    }
+
+    fflush(static_cast<FILE *>(file));
+    return true;
+#endif
+}
+
+bool FlashRegion::erase(int sector)
+{
+    if(sector < 0 || sector >= num_sectors)
+        return false;
+
+#if PICO_ON_DEVICE
+    auto irq = save_and_disable_interrupts();
+    flash_range_erase(offset + sector * sector_size, sector_size);
+    restore_interrupts(irq);
+
+    return true;
+#else
+    uint8_t erased[sector_size];
+    memset(erased, 0xFF, sector_size);
+
+    auto f = static_cast<FILE *>(file);
+    if(!f || fseek(f, sector * sector_size, SEEK_SET) != 0 || fwrite(erased, 1, sector_size, f) != sector_size)
+        return false;
+
+    fflush(f);
+    return true;
+#endif
+}
+
+bool FlashRegion::in_range(uint32_t addr, size_t len) const
+{
+    return addr <= num_sectors * sector_size && len <= num_sectors * sector_size - addr;
+}
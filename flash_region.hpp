@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// a few sectors of flash for storing data, or a file standing in for them when not on the device
+// behaves like NOR flash: erasing sets every byte to 0xFF and programming can only clear bits
+class FlashRegion final
+{
+public:
+    static constexpr uint32_t sector_size = 4096;
+
+    // offset is from the start of flash and sector aligned
+    FlashRegion(uint32_t offset, int num_sectors);
+
+    bool init();
+
+    int getNumSectors() const;
+
+    // addresses are relative to the start of the region
+    bool read(uint32_t addr, void *data, size_t len) const;
+
+    // any alignment/length, bytes outside the range are left as they were
+    bool program(uint32_t addr, const void *data, size_t len);
+
+    bool erase(int sector);
+
+private:
+    bool in_range(uint32_t addr, size_t len) const;
+
+    uint32_t offset;
+    int num_sectors;
+
+#if !PICO_ON_DEVICE
+    void *file = nullptr;
+#endif
+};
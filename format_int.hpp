@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// decimal formatting without going through printf
+// writes at most format_int_max_len chars (no terminator), returns the length
+
+static constexpr size_t format_int_max_len = 11; // -2147483648
+
+inline size_t format_uint(char *out, uint32_t value)
+{
+    char tmp[10];
+    size_t len = 0;
+
+    do
+    {
+        tmp[len++] = '0' + value % 10;
+        value /= 10;
+    }
+    while(value);
+
+    for(size_t i = 0; i < len; i++)
+        out[i] = tmp[len - 1 - i];
+
+    return len;
+}
+
+inline size_t format_int(char *out, int32_t value)
+{
+    if(value >= 0)
+        return format_uint(out, value);
+
+    *out = '-';
+    return format_uint(out + 1, -uint32_t(value)) + 1;
+}
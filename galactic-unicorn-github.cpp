@@ -1,5 +1,9 @@
+#include <algorithm>
 #include <charconv>
+#include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <queue>
 
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
@@ -9,227 +13,1551 @@
 #include "galactic_unicorn.hpp"
 #include "pico_graphics.hpp"
 
-#include "tiny-json.h"
+#include "calendar_cache.hpp"
+#include "contribution_calendar.hpp"
+#include "contribution_level.hpp"
+#include "date.hpp"
+#include "entropy_pool.hpp"
+#include "flash_region.hpp"
+#include "graphql_pager.hpp"
+#include "graphql_template.hpp"
+#include "http_cache.hpp"
+#include "http_client.hpp"
+#include "json_path.hpp"
+#include "json_stream.hpp"
+#include "kv_store.hpp"
+#include "quantize.hpp"
+#include "rate_limiter.hpp"
+#include "refresh_policy.hpp"
+#include "single_flight.hpp"
+#include "tls_arena.hpp"
+#include "tls_config.hpp"
+
+const char *ssid = WIFI_SSID;
+const char *password = WIFI_PASSWORD;
+
+static constexpr const char *github_login = "Daft-Freak";
+
+// queries are minified into body templates at compile time, so building a request is just filling in the slots
+static constexpr std::string_view contributionsQueryStart = R"(
+query($login:String!) { 
+    user(login: $login){)";
+
+// one aliased contributionsCollection per year, so several years can be fetched in one request
+// contributionLevel for GitHub's 5 levels, or contributionCount to quantize ourselves
+static constexpr std::string_view contributionsQueryYear = R"(
+        y%i: contributionsCollection(from: "%i-01-01T00:00:00", to: "%i-12-31T23:59:59") {
+            contributionCalendar {
+                weeks {
+                    contributionDays {
+                        %s
+                    }
+                }
+            }
+        })";
+
+// just the last few days, to patch into a calendar we already have
+static constexpr std::string_view contributionsQueryRecent = R"(
+        recent: contributionsCollection(from: "%sT00:00:00", to: "%sT23:59:59") {
+            contributionCalendar {
+                weeks {
+                    contributionDays {
+                        date
+                        %s
+                    }
+                }
+            }
+        })";
+
+// the cost and remaining budget come back with every query, for the rate limiter
+static constexpr std::string_view contributionsQueryEnd = R"(
+    }
+    rateLimit {
+        cost
+        remaining
+        resetAt
+    }
+})";
+
+static constexpr auto contributions_body_start = GRAPHQL_JSON(R"({"query":")") + GRAPHQL_QUERY(contributionsQueryStart);
+static constexpr auto contributions_body_year = GRAPHQL_QUERY(contributionsQueryYear);
+static constexpr auto contributions_body_recent = GRAPHQL_QUERY(contributionsQueryRecent);
+static constexpr auto contributions_body_end = GRAPHQL_QUERY(contributionsQueryEnd) + GRAPHQL_JSON(R"(","variables":{"login":"%s"}})");
+
+// every page of the user's repositories, as an example of a paginated query
+// pageInfo is first so the next page can be requested before the nodes have arrived
+static constexpr std::string_view repositoriesQuery = R"(
+query($login:String!, $after:String) {
+    user(login: $login) {
+        repositories(first: 100, after: $after, ownerAffiliations: OWNER) {
+            pageInfo {
+                endCursor
+                hasNextPage
+            }
+            nodes {
+                stargazerCount
+            }
+        }
+    }
+    rateLimit {
+        cost
+        remaining
+        resetAt
+    }
+})";
+
+static constexpr auto repositories_body_first = GRAPHQL_JSON(R"({"query":")") + GRAPHQL_QUERY(repositoriesQuery) + GRAPHQL_JSON(R"(","variables":{"login":"%s"}})");
+static constexpr auto repositories_body_next = GRAPHQL_JSON(R"({"query":")") + GRAPHQL_QUERY(repositoriesQuery) + GRAPHQL_JSON(R"(","variables":{"login":"%s","after":"%s"}})");
+static_assert(repositories_body_next.max_size <= GraphQLPager::max_body_len);
+
+static int year = 2022;
+
+// years fetched together, the one being shown and any uncached ones before it
+static constexpr int batch_years = 5;
+
+// compare a batched request against one request per year at startup
+static constexpr bool batch_benchmark = false;
+
+// patch the last refresh_days days into the current year periodically
+// with a full fetch of the year every full_refresh_every refreshes, in case anything older changed
+static constexpr int refresh_days = 2;
+static constexpr int full_refresh_every = 12;
+static uint32_t last_refresh_time = 0;
+static int refresh_count = 0;
+
+// the interval goes from min to idle depending on how active the user usually is at the time (from events and the calendar)
+// and doubles (up to max) after each refresh that found nothing new, it's never less than the rate limit allows for background requests
+static constexpr RefreshPolicy::Config refresh_config
+{
+    2 * 60 * 1000, // min
+    30 * 60 * 1000, // idle
+    6 * 60 * 60 * 1000, // max
+};
+static RefreshPolicy refresh_policy(refresh_config);
+
+// to see if the last refresh changed anything
+static bool refresh_full = false;
+static uint32_t refresh_hash = 0;
+static int refresh_changes = 0;
+
+// from the Date and ETag headers of the last response
+static Date today;
+static bool have_date = false;
+static char response_etag[64];
+
+// use raw counts split into count_levels steps (including none) instead of contributionLevel
+static constexpr bool count_mode = false;
+static constexpr int count_levels = 8;
+static_assert(count_levels >= 2 && count_levels <= quantize_max_levels);
+
+static constexpr const char *contributions_field = count_mode ? "contributionCount" : "contributionLevel";
+static constexpr auto calendar_kind = count_mode ? ContributionCalendar::Kind::Count : ContributionCalendar::Kind::Level;
+
+// parsed calendars are kept so switching back to a year is instant, least recently shown are dropped first
+static constexpr size_t calendar_cache_budget = 8 * 1024;
+
+// cached years older than this are drawn straight away, then fetched again in the background
+static constexpr uint32_t calendar_stale_ms = 60 * 60 * 1000;
+
+// fetch the years either side of the shown one while idle, so scrubbing to them is instant
+// only once nothing's been pressed for a while, and only while the rate limiter allows background requests
+static constexpr bool prefetch_enabled = true;
+static constexpr uint32_t prefetch_delay_ms = 1000;
+static int prefetched_year = 0;
+static uint32_t last_press_time = 0;
+
+// the GraphQL budget is shared by every device using the token
+// background requests (prefetch, revalidation, refresh, repository stats) leave rate_limit_reserve points for interactive ones
+// and are paced to spread the rest until the reset, at most rate_limit_burst at once
+static constexpr int rate_limit_reserve = 1000;
+static constexpr int rate_limit_burst = 5;
+static RateLimiter rate_limiter(rate_limit_reserve, rate_limit_burst);
+static bool background_deferred = false;
+
+using RequestPriority = RateLimiter::Priority;
+
+// a request identical to the one in flight (say a refresh and a press for the same year) waits for it instead of being sent again
+static SingleFlight<bool> request_flights;
+static SingleFlight<bool>::Key in_flight_key;
+
+using RequestDoneFunc = SingleFlight<bool>::DoneFunc;
+
+// year fetches waiting for the connection, a year the user is waiting for is sent before anything else
+enum class FetchPriority
+{
+    Prefetch = 0,
+    Revalidate,
+    Interactive
+};
+
+struct PendingFetch
+{
+    FetchPriority priority;
+    uint32_t sequence;
+    int year;
+
+    // oldest first within the same priority
+    bool operator<(const PendingFetch &other) const
+    {
+        return priority != other.priority ? priority < other.priority : sequence > other.sequence;
+    }
+};
+
+static std::priority_queue<PendingFetch> fetch_queue;
+static uint32_t fetch_sequence = 0;
+
+// open the connection ahead of a likely request and hold it for a while
+static constexpr bool prewarm_enabled = true;
+static constexpr uint32_t prewarm_idle_timeout_ms = 30000;
+static bool prewarm_pending = false;
+
+static TLSConfig tls_config;
+
+static HTTPClient client("api.github.com", tls_config.getAllocator());
+
+// total stars over all repositories, fetched once after the first calendar
+static constexpr bool fetch_repository_stats = false;
+static bool repository_stats_pending = fetch_repository_stats;
+static GraphQLPager repository_pager(client);
+static int repository_count = 0, repository_stars = 0;
+
+static constexpr auto repositories_path = json_path("data", "user", "repositories");
+static constexpr auto repositories_cursor_path = repositories_path + json_path("pageInfo", "endCursor");
+static constexpr auto repositories_has_next_path = repositories_path + json_path("pageInfo", "hasNextPage");
+static constexpr auto repositories_stars_path = repositories_path + json_path("nodes", json_each, "stargazerCount");
+
+static JSONStreamParser json_parser;
+static JSONPathMatcher json_matcher(json_parser);
+
+static constexpr auto calendar_weeks_path = json_path("data", "user", json_any_key, "contributionCalendar", "weeks");
+static constexpr auto calendar_days_path = calendar_weeks_path + json_path(json_each, "contributionDays");
+static constexpr auto calendar_level_path = calendar_days_path + json_path(json_each, "contributionLevel");
+static constexpr auto calendar_count_path = calendar_days_path + json_path(json_each, "contributionCount");
+static constexpr auto calendar_date_path = calendar_days_path + json_path(json_each, "date");
+static constexpr auto error_message_path = json_path("errors", json_each, "message");
+
+static constexpr auto event_time_path = json_path(json_each, "created_at");
+
+static constexpr auto rate_limit_cost_path = json_path("data", "rateLimit", "cost");
+static constexpr auto rate_limit_remaining_path = json_path("data", "rateLimit", "remaining");
+static constexpr auto rate_limit_reset_path = json_path("data", "rateLimit", "resetAt");
+
+// until resetAt, which is last
+static int graphql_cost = 0, graphql_remaining = 0;
+
+static unsigned int response_len = 0, response_received = 0, response_header_bytes = 0;
+static uint32_t response_parse_time = 0;
+static uint32_t request_start_time = 0;
+static bool request_in_progress = false;
+
+// totals for the last complete request
+static uint32_t last_request_time_ms = 0, last_request_bytes = 0;
+
+// responses are parsed into the cache, and drawn from it
+// the parsing is in the lwIP callbacks, which run in an IRQ, so the main loop uses it with the lwIP lock held
+// (not while sending though, connecting waits for the callbacks)
+static CalendarCache calendar_cache(calendar_cache_budget);
+static ContributionCalendar *parsing_calendar = nullptr;
+static int parsing_year = 0;
+
+// refetching a stale year that's already drawn, so redraw it once at the end instead of clearing
+static bool revalidating = false;
+
+// calendars and the last shown year are kept in flash, so something can be drawn straight after boot
+// written from the main loop once a response is done, as flash writes have to stop everything else
+static constexpr int store_sectors = 16;
+static FlashRegion store_flash(PICO_FLASH_SIZE_BYTES - store_sectors * FlashRegion::sector_size, store_sectors);
+static KVStore store(store_flash);
+static bool store_ready = false;
+static int stored_year = 0;
+
+// stored before each calendar
+struct StoredCalendarInfo
+{
+    int32_t fetch_day; // days since 1970, 0 if unknown
+    char etag[sizeof(response_etag)];
+};
+
+static int unsaved_years[batch_years + 1];
+static int num_unsaved_years = 0;
+
+// the user's recent public events over REST, with conditional requests (a 304 doesn't count against the rate limit)
+// only the timestamps are kept, which is also all that's stored
+static constexpr bool fetch_events = true;
+static constexpr uint32_t events_interval_ms = 10 * 60 * 1000;
+static constexpr int max_events = 30;
+static HTTPCache http_cache(client, store);
+static bool events_fetched = false;
+static uint32_t last_events_time = 0;
+
+static uint32_t event_times[max_events]; // seconds since 1970, newest first
+static int num_events = 0;
+
+// filled in as a modified response is parsed
+static uint32_t new_event_times[max_events];
+static int num_new_events = 0;
+
+// days in the week currently being parsed
+static int week_num_days = 0;
+
+// parsing the recent days, which are patched into the existing calendars by date
+static bool parsing_recent = false;
+static Date recent_date;
+
+// cells of the displayed year changed by the last patch
+static constexpr int max_patched_days = refresh_days + 7;
+static int patched_days[max_patched_days][2];
+static int num_patched_days = 0;
+
+// count mode needs the whole year before anything can be drawn
+static QuantizeThresholds count_thresholds;
+static uint16_t count_scratch[ContributionCalendar::max_weeks * 8];
+
+// zoomed out views, C cycles through them
+// range totals come from the calendar's prefix sums, so switching doesn't refetch or rescan anything
+enum class CalendarView
+{
+    Days,    // a pixel per day
+    Weeks,   // weekly totals, a row per cached year up to the shown one
+    Months,  // monthly totals of the shown year, as bars
+    Average, // rolling 7-day average across the shown year, as bars
+    Count
+};
+
+static const char *const view_names[]{"days", "weeks", "months", "average"};
+static_assert(std::size(view_names) == size_t(CalendarView::Count));
+
+static CalendarView view = CalendarView::Days;
+static constexpr int view_years = 11; // a row each
+static constexpr int month_bar_width = 4; // 12 of them fit in 53 columns
+static uint16_t week_totals[view_years * ContributionCalendar::max_weeks];
+static uint16_t week_scratch[view_years * ContributionCalendar::max_weeks];
+
+static CalendarCache::Key calendar_key(int year)
+{
+    return {github_login, year, calendar_kind};
+}
+
+// week * 7 + day, the first week starts on a Sunday so is missing the days before January 1st
+static int calendar_day(const Date &date)
+{
+    return day_of_year(date) + day_of_week({date.year, 1, 1});
+}
+
+static std::string_view store_key(char *buf, size_t buf_len, int year)
+{
+    int len = snprintf(buf, buf_len, "cal/%s/%i/%i", github_login, year, int(calendar_kind));
+    return {buf, size_t(std::max(len, 0))};
+}
+
+static void mark_unsaved(int year)
+{
+    for(int i = 0; i < num_unsaved_years; i++)
+    {
+        if(unsaved_years[i] == year)
+            return;
+    }
+
+    if(num_unsaved_years < int(std::size(unsaved_years)))
+        unsaved_years[num_unsaved_years++] = year;
+}
+
+// writes anything changed by the last response, and the shown year if that changed
+static void save_calendars()
+{
+    if(!store_ready)
+        return;
+
+    static uint8_t buf[sizeof(StoredCalendarInfo) + ContributionCalendar::max_serialized_size];
+    char key_buf[64];
+
+    for(int i = 0; i < num_unsaved_years; i++)
+    {
+        int y = unsaved_years[i];
+
+        // being fetched again, saved once that's done
+        cyw43_arch_lwip_begin();
+
+        if(!calendar_cache.contains(calendar_key(y)))
+        {
+            cyw43_arch_lwip_end();
+            continue;
+        }
+
+        auto calendar = calendar_cache.find(calendar_key(y));
+
+        StoredCalendarInfo info = {};
+        info.fetch_day = have_date ? days_from_date(today) : 0;
+        memcpy(info.etag, response_etag, sizeof(info.etag));
+
+        memcpy(buf, &info, sizeof(info));
+        size_t len = sizeof(info) + calendar->serialize(buf + sizeof(info));
+
+        // not while writing the flash
+        cyw43_arch_lwip_end();
+
+        if(!store.put(store_key(key_buf, sizeof(key_buf), y), buf, len))
+            printf("failed to store %i\n", y);
+    }
+
+    num_unsaved_years = 0;
+
+    if(year != stored_year && store.put("year", &year, sizeof(year)))
+        stored_year = year;
+}
+
+// into the cache, marked stale so it's refetched when shown
+static bool load_calendar(int year)
+{
+    if(!store_ready)
+        return false;
+
+    static uint8_t buf[sizeof(StoredCalendarInfo) + ContributionCalendar::max_serialized_size];
+    char key_buf[64];
+
+    int len = store.get(store_key(key_buf, sizeof(key_buf), year), buf, sizeof(buf));
+    if(len < int(sizeof(StoredCalendarInfo)))
+        return false;
+
+    StoredCalendarInfo info;
+    memcpy(&info, buf, sizeof(info));
+
+    ContributionCalendar calendar;
+    if(!calendar.deserialize(buf + sizeof(info), len - sizeof(info)))
+        return false;
+
+    auto key = calendar_key(year);
+    calendar_cache.insert(key) = std::move(calendar);
+    calendar_cache.update(key);
+    calendar_cache.markStale(key);
+
+    auto fetched = date_from_days(info.fetch_day);
+    printf("loaded %i from flash, fetched %i-%02i-%02i\n", year, fetched.year, fetched.month, fetched.day);
+
+    return true;
+}
+
+static bool is_stored(int year)
+{
+    char key_buf[64];
+    return store_ready && store.getLength(store_key(key_buf, sizeof(key_buf), year)) >= 0;
+}
+
+// unicorn/graphics
+pimoroni::PicoGraphics_PenRGB888 graphics(53, 11, nullptr);
+
+static const uint8_t level_colours[][3]
+{
+    {0x00, 0x00, 0x00},
+    {0x0E, 0x22, 0x14},
+    {0x00, 0x6D, 0x32},
+    {0x36, 0xB6, 0x51},
+    {0x45, 0xFF, 0x64},
+};
+static_assert(std::size(level_colours) == size_t(ContributionLevel::Count));
+
+// ramp from the lowest to highest non-zero level colours
+static void count_level_colour(int level, uint8_t colour[3])
+{
+    auto &low = level_colours[1];
+    auto &high = level_colours[std::size(level_colours) - 1];
+
+    int steps = count_levels - 2;
+
+    for(int i = 0; i < 3; i++)
+        colour[i] = steps ? low[i] + (high[i] - low[i]) * (level - 1) / steps : high[i];
+}
+
+pimoroni::GalacticUnicorn galactic_unicorn;
+
+// returns false for days that should be left blank
+static bool day_colour(const ContributionCalendar &calendar, int week_no, int day_no, uint8_t colour[3])
+{
+    int level;
+
+    if(calendar.getKind() == ContributionCalendar::Kind::Count)
+    {
+        level = quantize_level(count_thresholds, calendar.getCount(week_no, day_no));
+        if(level == 0)
+            return false;
+
+        count_level_colour(level, colour);
+    }
+    else
+    {
+        level = int(calendar.getLevel(week_no, day_no));
+        if(level == 0)
+            return false;
+
+        for(int i = 0; i < 3; i++)
+            colour[i] = level_colours[level][i];
+    }
+
+    return true;
+}
+
+static void draw_day(const ContributionCalendar &calendar, int week_no, int day_no)
+{
+    uint8_t colour[3]{0, 0, 0};
+    day_colour(calendar, week_no, day_no, colour);
+
+    graphics.set_pen(colour[0], colour[1], colour[2]);
+    graphics.pixel({week_no, day_no});
+}
+
+static void draw_week(const ContributionCalendar &calendar, int week_no)
+{
+    for(int day_no = 0; day_no < 7; day_no++)
+    {
+        uint8_t colour[3];
+
+        // background is already cleared
+        if(!day_colour(calendar, week_no, day_no, colour))
+            continue;
+
+        graphics.set_pen(colour[0], colour[1], colour[2]);
+        graphics.pixel({week_no, day_no});
+    }
+}
+
+// returns true if the thresholds changed
+static bool update_count_thresholds(const ContributionCalendar &calendar)
+{
+    if(calendar.getKind() != ContributionCalendar::Kind::Count)
+        return false;
+
+    auto old_thresholds = count_thresholds;
+    count_thresholds = quantize_thresholds(calendar.getCounts(), calendar.getCountsLength(), count_levels, count_scratch);
+
+    printf("count thresholds:");
+    for(int i = 1; i < count_thresholds.num_levels; i++)
+        printf(" %u", count_thresholds.min_count[i]);
+    printf("\n");
+
+    return memcmp(&old_thresholds, &count_thresholds, sizeof(count_thresholds)) != 0;
+}
+
+static void draw_days(const ContributionCalendar &calendar)
+{
+    update_count_thresholds(calendar);
+
+    graphics.set_pen(0, 0, 0);
+    graphics.clear();
+
+    for(int week_no = 0; week_no < calendar.getNumWeeks(); week_no++)
+        draw_week(calendar, week_no);
+}
+
+// the shown year with its index built, nullptr if it isn't cached
+static const ContributionCalendar *get_indexed_calendar()
+{
+    auto key = calendar_key(year);
+
+    if(!calendar_cache.contains(key))
+        return nullptr;
+
+    auto calendar = calendar_cache.find(key);
+
+    // kept up to date from now on
+    if(!calendar->hasIndex())
+    {
+        calendar->buildIndex();
+        calendar_cache.updateSize(key);
+    }
+
+    return calendar;
+}
+
+// bottom up, scaled to the largest value, colours ramp up with height
+static void draw_bars(const uint32_t *values, int num_values, int bar_width)
+{
+    int height = pimoroni::GalacticUnicorn::HEIGHT;
+    uint32_t max_value = *std::max_element(values, values + num_values);
+
+    graphics.set_pen(0, 0, 0);
+    graphics.clear();
+
+    if(!max_value)
+        return;
+
+    for(int i = 0; i < num_values; i++)
+    {
+        // anything non-zero gets at least one pixel
+        int bar_height = (uint64_t(values[i]) * height + max_value - 1) / max_value;
+
+        for(int y = 0; y < bar_height; y++)
+        {
+            uint8_t colour[3];
+            count_level_colour(1 + y * (count_levels - 2) / (height - 1), colour);
+            graphics.set_pen(colour[0], colour[1], colour[2]);
+
+            for(int x = 0; x < bar_width; x++)
+                graphics.pixel({i * bar_width + x, height - 1 - y});
+        }
+    }
+}
+
+static void draw_weeks_view()
+{
+    int first_year = year - (view_years - 1);
+    int num_totals = 0;
+
+    // quantized together so the years can be compared
+    for(int row = 0; row < view_years; row++)
+    {
+        auto key = calendar_key(first_year + row);
+
+        if(!calendar_cache.contains(key))
+            continue;
+
+        auto calendar = calendar_cache.find(key);
+
+        for(int week_no = 0; week_no < calendar->getNumWeeks(); week_no++)
+            week_totals[num_totals++] = std::min(calendar->getWeekTotal(week_no), uint32_t(0xFFFF));
+    }
+
+    auto thresholds = quantize_thresholds(week_totals, num_totals, count_levels, week_scratch);
+
+    graphics.set_pen(0, 0, 0);
+    graphics.clear();
+
+    int total = 0;
+
+    for(int row = 0; row < view_years; row++)
+    {
+        auto key = calendar_key(first_year + row);
+
+        if(!calendar_cache.contains(key))
+            continue;
+
+        auto calendar = calendar_cache.find(key);
+
+        for(int week_no = 0; week_no < calendar->getNumWeeks(); week_no++)
+        {
+            int level = quantize_level(thresholds, week_totals[total++]);
+            if(level == 0)
+                continue;
+
+            uint8_t colour[3];
+            count_level_colour(level, colour);
+            graphics.set_pen(colour[0], colour[1], colour[2]);
+            graphics.pixel({week_no, row});
+        }
+    }
+}
+
+static void draw_months_view()
+{
+    auto calendar = get_indexed_calendar();
+    if(!calendar)
+        return;
+
+    uint32_t month_totals[12];
+
+    for(int month = 1; month <= 12; month++)
+    {
+        int first = calendar_day({year, month, 1});
+        int last = month == 12 ? calendar_day({year, 12, 31}) : calendar_day({year, month + 1, 1}) - 1;
+
+        month_totals[month - 1] = calendar->getTotal(first, last);
+    }
+
+    draw_bars(month_totals, 12, month_bar_width);
+}
+
+static void draw_average_view()
+{
+    auto calendar = get_indexed_calendar();
+    if(!calendar)
+        return;
+
+    constexpr int width = pimoroni::GalacticUnicorn::WIDTH;
+    int first = calendar_day({year, 1, 1});
+    int last = calendar_day({year, 12, 31});
+
+    // nothing after today yet
+    if(have_date && today.year == year)
+        last = calendar_day(today);
+
+    // the average at the last day of each column's share of the year, as a 7-day total (the scale doesn't matter)
+    uint32_t averages[width];
+
+    for(int x = 0; x < width; x++)
+    {
+        int day = first + (x + 1) * (last - first + 1) / width - 1;
+        averages[x] = day < first ? 0 : calendar->getTotal(day - 6, day);
+    }
+
+    draw_bars(averages, width, 1);
+}
+
+// the shown year in the current view
+static void draw_view()
+{
+    switch(view)
+    {
+        case CalendarView::Days:
+            if(calendar_cache.contains(calendar_key(year)))
+                draw_days(*calendar_cache.find(calendar_key(year)));
+            break;
+        case CalendarView::Weeks:
+            draw_weeks_view();
+            break;
+        case CalendarView::Months:
+            draw_months_view();
+            break;
+        case CalendarView::Average:
+            draw_average_view();
+            break;
+        case CalendarView::Count:
+            break;
+    }
+}
+
+static void draw_calendar(const ContributionCalendar &calendar)
+{
+    if(view == CalendarView::Days)
+        draw_days(calendar);
+    else
+        draw_view();
+}
+
+// only redraws what changed, unless that moved the count thresholds
+static void draw_patched_days()
+{
+    auto key = calendar_key(year);
+
+    if(!calendar_cache.contains(key) || !num_patched_days)
+        return;
+
+    auto calendar = calendar_cache.find(key);
+
+    // the totals are already up to date, the index was patched along with the days
+    if(view != CalendarView::Days)
+    {
+        draw_view();
+        return;
+    }
+
+    if(update_count_thresholds(*calendar))
+    {
+        draw_calendar(*calendar);
+        return;
+    }
+
+    for(int i = 0; i < num_patched_days; i++)
+        draw_day(*calendar, patched_days[i][0], patched_days[i][1]);
+}
+
+// value is a count or level, depending on the calendar
+static void patch_day(const Date &date, unsigned int value)
+{
+    // a fetch that stopped part way leaves an incomplete entry, which needs a full refresh instead
+    auto key = calendar_key(date.year);
+    if(!calendar_cache.contains(key))
+        return;
+
+    auto calendar = calendar_cache.find(key);
+
+    int pos = calendar_day(date);
+    int week_no = pos / 7, day_no = pos % 7;
+
+    bool is_count = calendar->getKind() == ContributionCalendar::Kind::Count;
+    unsigned int old_value = is_count ? calendar->getCount(week_no, day_no) : unsigned(calendar->getLevel(week_no, day_no));
+
+    if(value == old_value)
+        return;
+
+    printf("%i-%02i-%02i changed %u -> %u\n", date.year, date.month, date.day, old_value, value);
+
+    refresh_changes++;
+
+    if(is_count)
+        calendar->setCount(week_no, day_no, value);
+    else
+        calendar->setLevel(week_no, day_no, ContributionLevel(value));
+
+    // fresh again, and possibly a different size
+    calendar_cache.update(key);
+    mark_unsaved(date.year);
+
+    if(date.year == year && num_patched_days < max_patched_days)
+    {
+        patched_days[num_patched_days][0] = week_no;
+        patched_days[num_patched_days][1] = day_no;
+        num_patched_days++;
+    }
+}
+
+static void init_rate_limit_paths(JSONPathMatcher &matcher)
+{
+    using Event = JSONStreamParser::Event;
+
+    matcher.on(rate_limit_cost_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::Number)
+            std::from_chars(value.data(), value.data() + value.length(), graphql_cost);
+    });
+
+    matcher.on(rate_limit_remaining_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::Number)
+            std::from_chars(value.data(), value.data() + value.length(), graphql_remaining);
+    });
+
+    matcher.on(rate_limit_reset_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::String)
+            rate_limiter.onGraphQLRateLimit(graphql_cost, graphql_remaining, value);
+    });
+}
+
+// handlers for the parts of the response we use
+// these are called as it streams in, so in level mode each week is drawn as soon as it's complete
+static void init_json_paths()
+{
+    using Event = JSONStreamParser::Event;
+
+    json_matcher.on(calendar_weeks_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::ArrayStart)
+        {
+            auto alias = json_matcher.getAnyKey(0);
+
+            parsing_recent = alias == "recent";
+            if(parsing_recent)
+                return;
+
+            // other aliases are y<year>
+            parsing_year = 0;
+            if(alias.length() > 1)
+                std::from_chars(alias.data() + 1, alias.data() + alias.length(), parsing_year);
+
+            parsing_calendar = &calendar_cache.insert(calendar_key(parsing_year));
+            parsing_calendar->reset(calendar_kind);
+
+            // other views stay up until the year is done
+            if(parsing_year == year && !revalidating && view == CalendarView::Days)
+            {
+                graphics.set_pen(0, 0, 0);
+                graphics.clear();
+            }
+        }
+        else if(event == Event::ArrayEnd)
+        {
+            if(parsing_calendar)
+            {
+                // complete before drawing, so the other views can see it
+                calendar_cache.update(calendar_key(parsing_year));
+                mark_unsaved(parsing_year);
+
+                if((count_mode || revalidating || view != CalendarView::Days) && parsing_year == year)
+                    draw_calendar(*parsing_calendar);
+            }
+
+            parsing_recent = false;
+
+            parsing_calendar = nullptr;
+        }
+    });
+
+    json_matcher.on(calendar_days_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::ArrayStart)
+            week_num_days = 0;
+        else if(event == Event::ArrayEnd && parsing_calendar)
+        {
+            int week_no = json_matcher.getEachIndex(0);
+
+            if(week_no == 0)
+                parsing_calendar->alignFirstWeek(week_num_days);
+
+            if(!count_mode && !revalidating && view == CalendarView::Days && parsing_year == year)
+                draw_week(*parsing_calendar, week_no);
+        }
+    });
+
+    // requested before the value, so it's known when patching
+    json_matcher.on(calendar_date_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::String && !parse_iso_date(value, recent_date))
+            recent_date = {};
+    });
+
+    json_matcher.on(calendar_level_path, [](Event event, std::string_view value)
+    {
+        if(event != Event::String)
+            return;
+
+        auto level = contribution_level_from_string(value);
+
+        if(parsing_recent)
+            patch_day(recent_date, unsigned(level));
+        else if(parsing_calendar)
+            parsing_calendar->setLevel(json_matcher.getEachIndex(0), week_num_days++, level);
+    });
+
+    json_matcher.on(calendar_count_path, [](Event event, std::string_view value)
+    {
+        if(event != Event::Number)
+            return;
+
+        // saturate rather than wrap on very busy days
+        unsigned int count = 0;
+        if(std::from_chars(value.data(), value.data() + value.length(), count).ec == std::errc::result_out_of_range)
+            count = 0xFFFF;
+
+        count = std::min(count, 0xFFFFu);
+
+        if(parsing_recent)
+            patch_day(recent_date, count);
+        else if(parsing_calendar)
+            parsing_calendar->setCount(json_matcher.getEachIndex(0), week_num_days++, count);
+    });
+
+    json_matcher.on(error_message_path, [](Event event, std::string_view value)
+    {
+        printf("GraphQL error: %.*s\n", value.length(), value.data());
+    });
+
+    json_matcher.on(event_time_path, [](Event event, std::string_view value)
+    {
+        if(event == Event::String && num_new_events < max_events && parse_iso_time(value, new_event_times[num_new_events]))
+            num_new_events++;
+    });
+
+    init_rate_limit_paths(json_matcher);
+}
+
+// on_done is called when the response has been parsed, for this request or the identical one it joined
+static bool send_request(const char *body, size_t body_len, RequestPriority priority, RequestDoneFunc on_done = nullptr)
+{
+    auto key = request_flights.makeKey("POST", client.getHost(), "/graphql", {body, body_len});
+
+    if(request_flights.join(key, on_done))
+    {
+        printf("joined in-flight request\n");
+        return true;
+    }
+
+    if(request_in_progress || repository_pager.isBusy() || http_cache.isBusy())
+        return false;
+
+    if(!rate_limiter.canSend(priority))
+    {
+        printf("rate limited, not sending\n");
+        return false;
+    }
+
+    // tls
+    if(!tls_config.init())
+        return false;
+
+    client.setOnStatus([](int code, std::string_view message)
+    {
+        printf("Status code: %i, message: %.*s\n", code, message.length(), message.data());
+        rate_limiter.onStatus(code);
+    });
+
+    response_len = response_received = response_header_bytes = 0;
+    response_parse_time = 0;
+
+    json_parser.reset();
+
+    client.setOnHeader([](std::string_view name, std::string_view value)
+    {
+        printf("Header: %.*s, value: %.*s\n", name.length(), name.data(), value.length(), value.data());
+
+        response_header_bytes += name.length() + value.length() + 4;
+
+        if(HTTPClient::headerNameEquals(name, "Date"))
+            have_date = parse_http_date(value, today) || have_date;
+
+        rate_limiter.onHeader(name, value);
+
+        if(HTTPClient::headerNameEquals(name, "ETag"))
+            snprintf(response_etag, sizeof(response_etag), "%.*s", int(value.length()), value.data());
+
+        if(HTTPClient::headerNameEquals(name, "Content-Length"))
+        {
+            // only for the diagnostics, the client finds the end of the body
+            if(std::from_chars(value.data(), value.data() + value.length(), response_len).ec != std::errc())
+            {
+                printf("bad Content-Length\n");
+                response_len = 0;
+            }
+        }
+    });
+
+    client.setOnBodyData([](unsigned int len, uint8_t *data)
+    {
+        auto start = time_us_32();
+        json_parser.feed(data, len);
+        response_parse_time += time_us_32() - start;
+
+        response_received += len;
+    });
+
+    // after Content-Length bytes, the last chunk or the server closing
+    client.setOnResponseComplete([]()
+    {
+        if(!json_parser.isDone() && !json_parser.hasError())
+            printf("JSON response incomplete!\n");
+
+        json_parser.printStats();
+        printf("parsed %u bytes in %u us\n", response_received, response_parse_time);
+
+        last_request_time_ms = (time_us_32() - request_start_time) / 1000;
+        last_request_bytes = response_header_bytes + response_received;
+        printf("request took %u ms, %u bytes received\n", last_request_time_ms, last_request_bytes);
+
+        draw_patched_days();
+        num_patched_days = 0;
 
-#include "http_client.hpp"
+        calendar_cache.printStats();
+        rate_limiter.printStats();
 
-const char *ssid = WIFI_SSID;
-const char *password = WIFI_PASSWORD;
+        request_in_progress = false;
+        revalidating = false;
 
-// contributionLevel for 5 levels, could use contributionCount for more detail
-const char *contributionsQuery = R"(
-query($login:String!, $startTime:DateTime) { 
-    user(login: $login){
-        contributionsCollection(from: $startTime) {
-            contributionCalendar {
-                weeks {
-                    contributionDays {
-                        contributionLevel
-                    }
-                }
-            }
-        }
-    }
-})";
+        // probably about to scrub to another year
+        prewarm_pending = true;
 
-static int year = 2022;
+        tls_arena_print_stats("response");
+
+        // a truncated document isn't an error, but isn't done either
+        request_flights.complete(in_flight_key, json_parser.isDone());
+    });
 
-static json_t json_mem[1024];
+    num_patched_days = 0;
+    response_etag[0] = 0;
 
-static altcp_allocator_t tls_allocator = {
-    altcp_tls_alloc, nullptr
-};
+    // github API request
+    printf("Request body %.*s\n", body_len, body);
 
-static HTTPClient client("api.github.com", &tls_allocator);
+    tls_arena_reset_peak();
+    request_start_time = time_us_32();
 
-static std::string response_data;
-static unsigned int response_len = 0;
-static bool request_in_progress = false;
+    bool ret = client.post("/graphql", {body, body_len});
 
-// unicorn/graphics
-pimoroni::PicoGraphics_PenRGB888 graphics(53, 11, nullptr);
-pimoroni::GalacticUnicorn galactic_unicorn;
+    tls_arena_print_stats("handshake");
+    entropy_print_stats();
+
+    if(!ret)
+        return false;
+
+    rate_limiter.onSend(priority);
 
-// TODO: this isn't great and also probably should be somewhere else
-extern "C"
-int mbedtls_hardware_poll(void *data, unsigned char *output, size_t len, size_t *olen )
+    request_flights.begin(key, on_done);
+    in_flight_key = key;
+
+    request_in_progress = true;
+    return true;
+}
+
+// formats a template onto the end of a body, returns false if an arg didn't fit its slot
+template<class Template, class... Args>
+static bool append_body(char *body, size_t &body_len, const Template &tmpl, Args... args)
 {
-    *olen = 0;
-    for(size_t i = 0; i < len; i += 4)
+    size_t len = tmpl.format(body + body_len, args...);
+    if(!len)
     {
-        auto w = pico_lwip_rand();
-        *output++ = w;
-        *output++ = w >> 8;
-        *output++ = w >> 16;
-        *output++ = w >> 24;
-        *olen += 4;
+        printf("request body arg didn't fit\n");
+        return false;
     }
 
-    return 0;
+    body_len += len;
+    return true;
+}
+
+static bool request_years(const int *years, int num_years, RequestPriority priority = RequestPriority::Interactive, RequestDoneFunc on_done = nullptr)
+{
+    if(!num_years || num_years > batch_years)
+        return false;
+
+    static char body[contributions_body_start.max_size + contributions_body_year.max_size * batch_years + contributions_body_end.max_size];
+
+    size_t body_len = 0;
+
+    if(!append_body(body, body_len, contributions_body_start))
+        return false;
+
+    for(int i = 0; i < num_years; i++)
+    {
+        if(!append_body(body, body_len, contributions_body_year, years[i], years[i], years[i], contributions_field))
+            return false;
+    }
+
+    if(!append_body(body, body_len, contributions_body_end, github_login))
+        return false;
+
+    return send_request(body, body_len, priority, on_done);
+}
+
+// the last refresh_days days up to today
+static bool request_recent(RequestDoneFunc on_done = nullptr)
+{
+    static char body[contributions_body_start.max_size + contributions_body_recent.max_size + contributions_body_end.max_size];
+
+    char from[10], to[10];
+    std::string_view from_str(from, format_iso_date(from, date_from_days(days_from_date(today) - (refresh_days - 1))));
+    std::string_view to_str(to, format_iso_date(to, today));
+
+    size_t body_len = 0;
+
+    if(!append_body(body, body_len, contributions_body_start))
+        return false;
+
+    if(!append_body(body, body_len, contributions_body_recent, from_str, to_str, contributions_field))
+        return false;
+
+    if(!append_body(body, body_len, contributions_body_end, github_login))
+        return false;
+
+    return send_request(body, body_len, RequestPriority::Background, on_done);
+}
+
+// FNV-1a of the packed calendar
+static uint32_t calendar_hash(const ContributionCalendar &calendar)
+{
+    static uint8_t buf[ContributionCalendar::max_serialized_size];
+    size_t len = calendar.serialize(buf);
+
+    uint32_t hash = 2166136261;
+    for(size_t i = 0; i < len; i++)
+        hash = (hash ^ buf[i]) * 16777619;
+
+    return hash;
+}
+
+static void on_refresh_done(bool success)
+{
+    if(!success)
+        return;
+
+    auto key = calendar_key(today.year);
+    bool have_calendar = calendar_cache.contains(key);
+
+    // patches are counted as they're applied, a full fetch is compared with what was there before
+    bool changed = refresh_changes > 0;
+
+    if(refresh_full)
+        changed = !have_calendar || !refresh_hash || calendar_hash(*calendar_cache.find(key)) != refresh_hash;
+
+    refresh_policy.onRefresh(changed);
+
+    if(have_calendar)
+        refresh_policy.setCalendar(*calendar_cache.find(key));
+
+    printf("refresh %s, next in %u s\n", changed ? "changed" : "unchanged",
+        refresh_policy.getInterval(rate_limiter.getServerTime(), rate_limiter.getBackgroundInterval()) / 1000);
+    refresh_policy.printStats();
 }
 
-static void build_query_body(char *out, size_t out_len, const char *query, const char *variables = "{}")
+// patches the recent days, or refetches the whole year if it's time to reconcile (or a new year)
+// returns false if it couldn't be sent (or joined) yet
+static bool refresh()
 {
-    strcpy(out, "{\"query\": \"");
-    out += 11;
-    out_len += 11;
+    auto key = calendar_key(today.year);
 
-    // strip whitespace from query
-    for(auto p = query; *p && out_len; p++)
+    cyw43_arch_lwip_begin();
+
+    bool full = !calendar_cache.contains(key) || (refresh_count + 1) % full_refresh_every == 0;
+
+    refresh_full = full;
+    refresh_hash = full && calendar_cache.contains(key) ? calendar_hash(*calendar_cache.find(key)) : 0;
+    refresh_changes = 0;
+
+    cyw43_arch_lwip_end();
+
+    if(!(full ? request_years(&today.year, 1, RequestPriority::Background, on_refresh_done) : request_recent(on_refresh_done)))
+        return false;
+
+    if(full)
+        printf("refreshing %i\n", today.year);
+    else
+        printf("refreshing last %i days\n", refresh_days);
+
+    refresh_count++;
+    last_refresh_time = to_ms_since_boot(get_absolute_time());
+
+    return true;
+}
+
+// uses the stored timestamps if the events haven't changed
+static bool request_events()
+{
+    static char path[HTTPCache::max_path_len + 1];
+    snprintf(path, sizeof(path), "/users/%s/events/public?per_page=%i", github_login, max_events);
+
+    if(!tls_config.init())
+        return false;
+
+    json_parser.reset();
+    num_new_events = 0;
+
+    auto on_body = [](unsigned int len, uint8_t *data)
+    {
+        json_parser.feed(data, len);
+    };
+
+    auto on_done = [](HTTPCache::Result result, const uint8_t *data, size_t len)
     {
-        if(*p == ' ' || *p == '\n')
+        using Result = HTTPCache::Result;
+
+        if(result == Result::Modified)
         {
-            if(*(out - 1) != ' ')
-            {
-                *out++ = ' ';
-                out_len--;
-            }
+            num_events = num_new_events;
+            memcpy(event_times, new_event_times, num_events * sizeof(uint32_t));
 
-            continue;
+            http_cache.setResult(event_times, num_events * sizeof(uint32_t));
         }
-        
-        *out++ = *p;
-        out_len--;
-    }
+        else if(data)
+        {
+            num_events = std::min(len / sizeof(uint32_t), size_t(max_events));
+            memcpy(event_times, data, num_events * sizeof(uint32_t));
+        }
+
+        static const char *result_names[]{"fresh", "not modified", "modified", "failed"};
+        printf("%i events (%s)\n", num_events, result_names[int(result)]);
+
+        refresh_policy.setEventTimes(event_times, num_events);
 
-    snprintf(out, out_len, "\", \"variables\": %s}", variables);
+        http_cache.printStats();
+    };
+
+    return http_cache.get(path, on_body, on_done);
 }
 
-static void parse_response_json(std::string &str)
+static void init_repository_pager()
 {
-    auto json = json_create(str.data(), json_mem, std::size(json_mem));
+    using Event = JSONStreamParser::Event;
+
+    repository_pager.setPageInfoPaths(repositories_cursor_path, repositories_has_next_path);
 
-    if(!json)
+    // aggregated as each page streams in
+    repository_pager.getMatcher().on(repositories_stars_path, [](Event event, std::string_view value)
     {
-        printf("JSON parse failed!\n");
-        return;
-    }
+        int stars = 0;
+        if(event == Event::Number && std::from_chars(value.data(), value.data() + value.length(), stars).ec == std::errc())
+        {
+            repository_count++;
+            repository_stars += stars;
+        }
+    });
+
+    repository_pager.setBodyBuilder([](char *out, std::string_view cursor)
+    {
+        if(cursor.empty())
+            return repositories_body_first.format(out, github_login);
+
+        return repositories_body_next.format(out, github_login, cursor);
+    });
+
+    repository_pager.setOnPage([](int page)
+    {
+        printf("repositories page %i: %i so far, %i stars\n", page, repository_count, repository_stars);
+    });
+
+    // these count against the same budget
+    repository_pager.setOnStatus([](int code, std::string_view message)
+    {
+        rate_limiter.onStatus(code);
+    });
+
+    repository_pager.setOnHeader([](std::string_view name, std::string_view value)
+    {
+        rate_limiter.onHeader(name, value);
+    });
+
+    init_rate_limit_paths(repository_pager.getMatcher());
+
+    repository_pager.setOnDone([](bool success, int pages)
+    {
+        if(success)
+            printf("%i repositories, %i stars\n", repository_count, repository_stars);
+    });
+}
+
+static void queue_fetch(int year, FetchPriority priority)
+{
+    fetch_queue.push({priority, fetch_sequence++, year});
+}
 
-    json = json_getProperty(json, "data");
-    if(json)
-        json = json_getProperty(json, "user");
-    if(json)
-        json = json_getProperty(json, "contributionsCollection");
-    if(json)
-        json = json_getProperty(json, "contributionCalendar");
+// draws the year if it's cached (refetching it if stale), otherwise queues a fetch for it
+static void show_year()
+{
+    auto key = calendar_key(year);
+
+    // an incomplete entry is from a fetch that failed part way (unless it's still being parsed)
+    if(!calendar_cache.contains(key) && !(parsing_calendar && parsing_year == year))
+        load_calendar(year);
 
-    if(!json || json_getType(json) != JSON_OBJ)
+    if(auto calendar = calendar_cache.get(key))
     {
-        printf("contributionsCalendar not found!\n");
+        draw_calendar(*calendar);
+        calendar_cache.printStats();
+
+        if(calendar_cache.getAge(key) >= calendar_stale_ms)
+            queue_fetch(year, FetchPriority::Revalidate);
+
         return;
     }
 
-    auto weeks = json_getProperty(json, "weeks");
+    // don't leave the previous year up while waiting, unless it's the one already being fetched
+    if(!request_in_progress || parsing_year != year)
+    {
+        graphics.set_pen(0, 0, 0);
+        graphics.clear();
+    }
+
+    queue_fetch(year, FetchPriority::Interactive);
+}
+
+// the years either side of the shown one, once it's loaded
+static void queue_prefetch()
+{
+    if(!prefetch_enabled || prefetched_year == year || !calendar_cache.contains(calendar_key(year)))
+        return;
+
+    prefetched_year = year;
 
-    if(!weeks || json_getType(weeks) != JSON_ARRAY)
+    for(int y : {year - 1, year + 1})
     {
-        printf("weeks array not found!\n");
+        if(have_date && y > today.year)
+            continue;
+
+        if(!calendar_cache.contains(calendar_key(y)) && !is_stored(y))
+            queue_fetch(y, FetchPriority::Prefetch);
+    }
+}
+
+// the connection dropped before the whole response arrived, anything waiting on it fails
+static void check_request_lost()
+{
+    if(!request_in_progress || client.isConnected() || client.getPendingResponses())
         return;
+
+    printf("request lost after %u of %u bytes\n", response_received, response_len);
+
+    // whatever was being parsed stays incomplete, so it's fetched again
+    request_in_progress = false;
+    revalidating = false;
+    parsing_calendar = nullptr;
+    parsing_recent = false;
+    num_patched_days = 0;
+
+    request_flights.complete(in_flight_key, false);
+}
+
+// nothing using the connection
+static bool client_idle()
+{
+    return !request_in_progress && !repository_pager.isBusy() && !http_cache.isBusy();
+}
+
+// logs when background requests start/stop being held back
+static bool background_allowed()
+{
+    bool allowed = rate_limiter.canSend(RequestPriority::Background);
+
+    if(allowed == background_deferred)
+    {
+        background_deferred = !allowed;
+
+        if(background_deferred)
+            printf("deferring background requests for %u ms\n", rate_limiter.getWaitTime(RequestPriority::Background));
+        else
+            printf("background requests resumed\n");
     }
 
-    graphics.set_pen(0, 0, 0);
-    graphics.clear();
+    return allowed;
+}
+
+// draws the shown year once a fetch for it is done, if that didn't already happen while parsing
+static void on_year_fetched(bool success)
+{
+    auto key = calendar_key(year);
+
+    if(success && calendar_cache.contains(key))
+        draw_calendar(*calendar_cache.find(key));
+}
 
-    int week_no = 0;
-    for(auto week = json_getChild(weeks); week; week = json_getSibling(week), week_no++)
+// sends the next fetch in the queue, or joins an identical request if one is already in flight
+static void send_queued_fetch()
+{
+    while(!fetch_queue.empty())
     {
-        auto days = json_getProperty(week, "contributionDays");
-        if(!days || json_getType(days) != JSON_ARRAY)
+        auto fetch = fetch_queue.top();
+        auto key = calendar_key(fetch.year);
+
+        // no longer needed: moved on to another year, already got it some other way, or no longer next to the shown year
+        bool drop;
+
+        cyw43_arch_lwip_begin();
+
+        if(fetch.priority == FetchPriority::Interactive)
+            drop = fetch.year != year || calendar_cache.contains(key);
+        else if(fetch.priority == FetchPriority::Revalidate)
+            drop = calendar_cache.getAge(key) < calendar_stale_ms;
+        else
+            drop = std::abs(fetch.year - year) > 1 || calendar_cache.contains(key) || is_stored(fetch.year);
+
+        cyw43_arch_lwip_end();
+
+        if(drop)
+        {
+            fetch_queue.pop();
             continue;
+        }
+
+        bool busy = !client_idle();
+        bool sent;
+
+        if(fetch.priority == FetchPriority::Interactive)
+        {
+            // the year on its own might already be in flight
+            if(busy)
+                sent = request_years(&fetch.year, 1, RequestPriority::Interactive, on_year_fetched);
+            else
+            {
+                // along with a few earlier uncached years
+                int years[batch_years];
+                int num_years = 0;
 
-        int num_days = 0;
-        for(auto day = json_getChild(days); day; day = json_getSibling(day))
-            num_days++;
+                cyw43_arch_lwip_begin();
+
+                for(int y = year; num_years < batch_years && y > year - batch_years * 2; y--)
+                {
+                    if(!calendar_cache.contains(calendar_key(y)) && !is_stored(y))
+                        years[num_years++] = y;
+                }
 
-        int day_no = 0;
+                cyw43_arch_lwip_end();
 
-        // adjust first week
-        if(week_no == 0 && num_days < 7)
-            day_no = 7 - num_days;
+                sent = request_years(years, num_years, RequestPriority::Interactive, on_year_fetched);
 
-        for(auto day = json_getChild(days); day; day = json_getSibling(day), day_no++)
+                // only refused by the rate limiter, don't keep trying
+                if(!sent)
+                    fetch_queue.pop();
+            }
+        }
+        else
         {
-            std::string_view level = json_getPropertyValue(day, "contributionLevel");
+            // prefetches wait for a pause in scrubbing, both wait for the rate limiter
+            if(fetch.priority == FetchPriority::Prefetch && to_ms_since_boot(get_absolute_time()) - last_press_time < prefetch_delay_ms)
+                return;
 
-            printf("W %i D %i %s\n", week_no, day_no, level.data());
+            if(!background_allowed())
+                return;
 
-            int index = 0;
+            bool revalidate = fetch.priority == FetchPriority::Revalidate;
 
-            if(level == "FIRST_QUARTILE")
-                graphics.set_pen(0x0E, 0x22, 0x14);
-            else if(level == "SECOND_QUARTILE")
-                graphics.set_pen(0x00, 0x6D, 0x32);
-            else if(level == "THIRD_QUARTILE")
-                graphics.set_pen(0x36, 0xB6, 0x51);
-            else if(level == "FOURTH_QUARTILE")
-                graphics.set_pen(0x45, 0xFF, 0x64);
-            else
-                continue;
+            // redraw at the end rather than clearing, unless joining a request that's already started
+            if(!busy)
+                revalidating = revalidate && fetch.year == year;
 
-            graphics.pixel({week_no, day_no});
+            sent = request_years(&fetch.year, 1, RequestPriority::Background);
+
+            if(!busy && !sent)
+                revalidating = false;
+
+            if(sent)
+                printf("%s %i\n", revalidate ? "revalidating" : "prefetching", fetch.year);
         }
+
+        // still busy with something else, try again later
+        if(sent)
+            fetch_queue.pop();
+
+        return;
     }
 }
 
-static void make_http_request()
+static bool wait_for_response(uint32_t timeout_ms = 30000)
 {
-    if(request_in_progress)
-        return;
+    auto timeout = make_timeout_time_ms(timeout_ms);
 
-    // tls
-    // FIXME: cert
-    if(!tls_allocator.arg)
-        tls_allocator.arg  = altcp_tls_create_config_client(nullptr, 0);
+    while(request_in_progress && absolute_time_diff_us(get_absolute_time(), timeout) > 0)
+    {
+        sleep_ms(1);
+        check_request_lost();
+    }
 
-    client.setOnStatus([](int code, std::string_view message)
+    return !request_in_progress;
+}
+
+// batch_years years in one request vs one request each
+static void run_batch_benchmark()
+{
+    int years[batch_years];
+    for(int i = 0; i < batch_years; i++)
+        years[i] = year - i;
+
+    uint32_t separate_time_ms = 0, separate_bytes = 0;
+
+    for(auto &y : years)
     {
-        printf("Status code: %i, message: %.*s\n", code, message.length(), message.data());
-    });
+        if(!request_years(&y, 1) || !wait_for_response())
+            return;
 
-    response_data.clear();
-    response_len = 0;
+        separate_time_ms += last_request_time_ms;
+        separate_bytes += last_request_bytes;
+    }
 
-    client.setOnHeader([](std::string_view name, std::string_view value)
+    if(!request_years(years, batch_years) || !wait_for_response())
+        return;
+
+    printf("%i years: separate requests %u ms, %u bytes, batched %u ms, %u bytes\n", batch_years,
+        separate_time_ms, separate_bytes, last_request_time_ms, last_request_bytes);
+}
+
+static void prewarm_connection()
+{
+    if(!prewarm_enabled || request_in_progress)
+        return;
+
+    if(!tls_config.init())
+        return;
+
+    if(!client.isConnected())
     {
-        printf("Header: %.*s, value: %.*s\n", name.length(), name.data(), value.length(), value.data());
+        printf("pre-warming connection\n");
+        client.prewarm();
+    }
+}
 
-        if(name == "Content-Length") // TODO: case
-        {
-            // TODO: check errors
-            std::from_chars(value.data(), value.data() + value.length(), response_len);
-            response_data.reserve(response_len);
-        }
-    });
+static bool any_button_pressed()
+{
+    using GU = pimoroni::GalacticUnicorn;
 
-    client.setOnBodyData([](unsigned int len, uint8_t *data)
+    for(auto button : {GU::SWITCH_C, GU::SWITCH_D, GU::SWITCH_SLEEP, GU::SWITCH_VOLUME_UP, GU::SWITCH_VOLUME_DOWN, GU::SWITCH_BRIGHTNESS_UP, GU::SWITCH_BRIGHTNESS_DOWN})
     {
-        response_data += std::string_view(reinterpret_cast<char *>(data), len);
+        if(galactic_unicorn.is_pressed(button))
+            return true;
+    }
 
-        if(response_data.length() == response_len)
-        {
-            parse_response_json(response_data);
-            request_in_progress = false;
-        }
-    });
+    return false;
+}
 
-    // github API request
-    char body[512];
-    char variables[128];
+// the last shown year, before there's any network
+static bool draw_stored_year()
+{
+    if(!store.init())
+        return false;
 
-    snprintf(variables, sizeof(variables), R"({"login" : "Daft-Freak", "startTime": "%i-01-01T00:00:00"})", year);
-    build_query_body(body, sizeof(body), contributionsQuery, variables);
+    store_ready = true;
 
-    printf("Request body %s\n", body);
+    if(store.get("year", &stored_year, sizeof(stored_year)) == sizeof(stored_year))
+        year = stored_year;
 
-    bool ret = client.post("/graphql", body, {
-        {"User-Agent", "PicoW"},
-        {"Authorization", "bearer " GITHUB_TOKEN}
-    });
+    if(!load_calendar(year))
+        return false;
 
-    if(!ret)
-        return;
+    draw_calendar(*calendar_cache.find(calendar_key(year)));
+    galactic_unicorn.update(&graphics);
 
-    request_in_progress = true;
+    return true;
 }
 
 static void status_message(const char *message)
@@ -250,9 +1578,17 @@ int main()
 
     galactic_unicorn.init();
 
+    entropy_init();
+
     graphics.set_pen(0);
     graphics.clear();
 
+    auto boot_start = time_us_32();
+    bool have_stored = draw_stored_year();
+
+    if(have_stored)
+        printf("drew stored calendar in %u us\n", time_us_32() - boot_start);
+
     if(cyw43_arch_init_with_country(CYW43_COUNTRY_UK))
     {
         printf("failed to initialise\n");
@@ -262,7 +1598,9 @@ int main()
 
     cyw43_arch_enable_sta_mode();
 
-    status_message("Connecting");
+    // leave the stored calendar up until there's something newer
+    if(!have_stored)
+        status_message("Connecting");
 
     printf("ssid %s pass %s\n", ssid, password);
 
@@ -276,22 +1614,108 @@ int main()
     }
     printf("wifi connected\n");
 
-    status_message("Connected.");
+    if(!have_stored)
+        status_message("Connected.");
+
+    client.setIdleTimeout(prewarm_idle_timeout_ms);
+    client.setDefaultHeaders({
+        {"User-Agent", "PicoW"},
+        {"Authorization", "bearer " GITHUB_TOKEN}
+    });
+
+    init_json_paths();
+    init_repository_pager();
+
+    if(batch_benchmark)
+        run_batch_benchmark();
+
+    cyw43_arch_lwip_begin();
+    show_year();
+    cyw43_arch_lwip_end();
 
-    make_http_request();
+    last_refresh_time = to_ms_since_boot(get_absolute_time());
+
+    bool was_touched = false, was_a = false, was_b = false, was_c = false;
 
     while(true)
     {
-        if(!request_in_progress && galactic_unicorn.is_pressed(pimoroni::GalacticUnicorn::SWITCH_A))
+        // any other button is a hint that A/B might be next
+        bool touched = any_button_pressed();
+        if(touched && !was_touched)
+            prewarm_pending = true;
+        was_touched = touched;
+
+        if(prewarm_pending && !request_in_progress)
+        {
+            prewarm_pending = false;
+            prewarm_connection();
+        }
+
+        client.update();
+        check_request_lost();
+        repository_pager.update();
+        http_cache.update();
+
+        if(repository_stats_pending && client_idle() && fetch_queue.empty() && background_allowed())
+        {
+            repository_stats_pending = false;
+            repository_count = repository_stars = 0;
+
+            if(tls_config.init() && repository_pager.start())
+                rate_limiter.onSend(RequestPriority::Background);
+        }
+
+        if(client_idle() && (num_unsaved_years || year != stored_year))
+            save_calendars();
+
+        cyw43_arch_lwip_begin();
+        queue_prefetch();
+        cyw43_arch_lwip_end();
+
+        send_queued_fetch();
+
+        auto now = to_ms_since_boot(get_absolute_time());
+
+        if(fetch_events && client_idle() && fetch_queue.empty() && (!events_fetched || now - last_events_time >= events_interval_ms))
+        {
+            events_fetched = true;
+            last_events_time = now;
+            request_events();
+        }
+
+        // may join a fetch of the same thing that's already in flight
+        if(fetch_queue.empty() && have_date && now - last_refresh_time >= refresh_policy.getInterval(rate_limiter.getServerTime(), rate_limiter.getBackgroundInterval()) && background_allowed())
+            refresh();
+
+        // one year per press, uncached years are queued ahead of anything in the background
+        bool a = galactic_unicorn.is_pressed(pimoroni::GalacticUnicorn::SWITCH_A);
+        bool b = galactic_unicorn.is_pressed(pimoroni::GalacticUnicorn::SWITCH_B);
+
+        if((a && !was_a) || (b && !was_b))
         {
-            year++;
-            make_http_request();
+            year += a ? 1 : -1;
+            last_press_time = to_ms_since_boot(get_absolute_time());
+
+            cyw43_arch_lwip_begin();
+            show_year();
+            cyw43_arch_lwip_end();
         }
-        else if(!request_in_progress && galactic_unicorn.is_pressed(pimoroni::GalacticUnicorn::SWITCH_B))
+
+        bool c = galactic_unicorn.is_pressed(pimoroni::GalacticUnicorn::SWITCH_C);
+
+        if(c && !was_c)
         {
-            year--;
-            make_http_request();
+            view = CalendarView((int(view) + 1) % int(CalendarView::Count));
+            printf("view: %s\n", view_names[int(view)]);
+
+            cyw43_arch_lwip_begin();
+            draw_view();
+            cyw43_arch_lwip_end();
         }
+
+        was_a = a;
+        was_b = b;
+        was_c = c;
         galactic_unicorn.update(&graphics);
         sleep_ms(10);
     }
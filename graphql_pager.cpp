@@ -0,0 +1,219 @@
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+#include "graphql_pager.hpp"
+
+GraphQLPager::GraphQLPager(HTTPClient &client, const char *path) : client(client), path(path), matcher(parser)
+{
+}
+
+JSONPathMatcher &GraphQLPager::getMatcher()
+{
+    return matcher;
+}
+
+void GraphQLPager::setBodyBuilder(BodyFunc fun)
+{
+    buildBody = fun;
+}
+
+void GraphQLPager::setOnPage(PageFunc fun)
+{
+    onPage = fun;
+}
+
+void GraphQLPager::setOnDone(DoneFunc fun)
+{
+    onDone = fun;
+}
+
+void GraphQLPager::setOnStatus(HTTPClient::StatusFunc fun)
+{
+    onStatus = fun;
+}
+
+void GraphQLPager::setOnHeader(HTTPClient::HeaderFunc fun)
+{
+    onHeader = fun;
+}
+
+void GraphQLPager::setPipelining(bool enabled)
+{
+    pipelining = enabled;
+}
+
+void GraphQLPager::setMaxPages(int max_pages)
+{
+    this->max_pages = max_pages;
+}
+
+bool GraphQLPager::start()
+{
+    if(busy || !buildBody)
+        return false;
+
+    busy = true;
+    failed = false;
+    cursor.clear();
+    has_next_page = next_pending = false;
+    pages_requested = pages_done = 0;
+    pipelined_pages = 0;
+    bytes = 0;
+    start_time = to_ms_since_boot(get_absolute_time());
+
+    parser.reset();
+
+    client.setOnStatus([this](int code, std::string_view message)
+    {
+        if(onStatus)
+            onStatus(code, message);
+
+        if(code != 200)
+        {
+            printf("page %i failed: %i %.*s\n", pages_done, code, message.length(), message.data());
+            failed = true;
+        }
+    });
+
+    client.setOnHeader(onHeader);
+
+    client.setOnBodyData([this](unsigned int len, uint8_t *data)
+    {
+        bytes += len;
+        parser.feed(data, len);
+    });
+
+    client.setOnResponseComplete([this]()
+    {
+        on_response_complete();
+    });
+
+    if(!request_next())
+    {
+        finish(false);
+        return false;
+    }
+
+    return true;
+}
+
+void GraphQLPager::update()
+{
+    if(!busy)
+        return;
+
+    if(next_pending)
+    {
+        next_pending = false;
+
+        if(!request_next())
+            finish(false);
+    }
+    else if(pages_requested > pages_done && !client.isConnected() && !client.getPendingResponses())
+    {
+        // connection dropped mid-response
+        printf("page %i lost\n", pages_done);
+        finish(false);
+    }
+}
+
+bool GraphQLPager::isBusy() const
+{
+    return busy;
+}
+
+void GraphQLPager::printStats() const
+{
+    printf("pages: %i (%i pipelined), %u bytes in %u ms\n", pages_done, pipelined_pages, bytes, end_time - start_time);
+}
+
+void GraphQLPager::on_end_cursor(Event event, std::string_view value)
+{
+    if(event == Event::String)
+        cursor = value;
+}
+
+void GraphQLPager::on_has_next_page(Event event)
+{
+    has_next_page = event == Event::True;
+
+    // don't wait for the rest of this page
+    bool can_pipeline = pipelining && client.isConnected() && pages_requested == pages_done + 1;
+
+    if(has_next_page && can_pipeline && !failed && pages_requested < max_pages)
+    {
+        if(request_next())
+            pipelined_pages++;
+        else
+            failed = true;
+    }
+}
+
+void GraphQLPager::on_response_complete()
+{
+    if(!busy)
+        return;
+
+    int page = pages_done++;
+
+    if(parser.hasError() || !parser.isDone())
+    {
+        printf("page %i: bad response\n", page);
+        failed = true;
+    }
+
+    if(!failed && onPage)
+        onPage(page);
+
+    parser.reset();
+
+    // the next page has to say if there's another
+    bool more = has_next_page;
+    has_next_page = false;
+
+    // waiting for a pipelined response
+    if(pages_requested > pages_done)
+        return;
+
+    if(failed || !more || pages_requested >= max_pages)
+    {
+        finish(!failed);
+        return;
+    }
+
+    // can't block in a callback if the connection has gone
+    if(client.isConnected())
+    {
+        if(!request_next())
+            finish(false);
+    }
+    else
+        next_pending = true;
+}
+
+bool GraphQLPager::request_next()
+{
+    size_t len = buildBody(body, cursor);
+
+    if(!len || len > sizeof(body))
+        return false;
+
+    if(!client.post(path, {body, len}))
+        return false;
+
+    pages_requested++;
+    return true;
+}
+
+void GraphQLPager::finish(bool success)
+{
+    busy = false;
+    next_pending = false;
+    end_time = to_ms_since_boot(get_absolute_time());
+
+    printStats();
+
+    if(onDone)
+        onDone(success, pages_done);
+}
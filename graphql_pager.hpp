@@ -0,0 +1,99 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "http_client.hpp"
+#include "json_path.hpp"
+#include "json_stream.hpp"
+
+// fetches every page of a GraphQL connection, streaming each through the same fixed-size parser
+// the query should request pageInfo { endCursor hasNextPage } before the nodes, so that the next page
+// can be requested (pipelined on the same connection) while the rest of the current one is still arriving
+class GraphQLPager final
+{
+public:
+    using Event = JSONStreamParser::Event;
+
+    // writes the body for the page after cursor (empty for the first page), returns the length
+    using BodyFunc = std::function<size_t(char *out, std::string_view cursor)>;
+    using PageFunc = std::function<void(int page)>;
+    using DoneFunc = std::function<void(bool success, int pages)>;
+
+    static constexpr size_t max_body_len = 2048;
+
+    GraphQLPager(HTTPClient &client, const char *path = "/graphql");
+
+    // bind paths to the nodes here to aggregate them as they're parsed
+    JSONPathMatcher &getMatcher();
+
+    // paths to the connection's pageInfo fields, must outlive the pager
+    template<size_t N, size_t M>
+    void setPageInfoPaths(const JSONPath<N> &end_cursor, const JSONPath<M> &has_next_page)
+    {
+        matcher.on(end_cursor, [this](Event event, std::string_view value){on_end_cursor(event, value);});
+        matcher.on(has_next_page, [this](Event event, std::string_view value){on_has_next_page(event);});
+    }
+
+    void setBodyBuilder(BodyFunc fun);
+    void setOnPage(PageFunc fun);
+    void setOnDone(DoneFunc fun);
+
+    // passed through from the client for every page, for things like rate limit headers
+    void setOnStatus(HTTPClient::StatusFunc fun);
+    void setOnHeader(HTTPClient::HeaderFunc fun);
+
+    // off waits for each response before requesting the next page
+    void setPipelining(bool enabled);
+    void setMaxPages(int max_pages);
+
+    bool start();
+
+    // sends a page request that couldn't be sent from the response callback, call regularly
+    void update();
+
+    bool isBusy() const;
+
+    void printStats() const;
+
+private:
+    void on_end_cursor(Event event, std::string_view value);
+    void on_has_next_page(Event event);
+    void on_response_complete();
+
+    bool request_next();
+    void finish(bool success);
+
+    HTTPClient &client;
+    const char *path;
+
+    JSONStreamParser parser;
+    JSONPathMatcher matcher;
+
+    BodyFunc buildBody;
+    PageFunc onPage;
+    DoneFunc onDone;
+    HTTPClient::StatusFunc onStatus;
+    HTTPClient::HeaderFunc onHeader;
+
+    bool pipelining = true;
+    int max_pages = 100;
+
+    bool busy = false;
+    bool failed = false;
+
+    // from the page currently being parsed
+    std::string cursor;
+    bool has_next_page = false;
+
+    bool next_pending = false; // needs sending from update
+    int pages_requested = 0, pages_done = 0;
+
+    // stats
+    int pipelined_pages = 0;
+    uint32_t bytes = 0;
+    uint32_t start_time = 0, end_time = 0;
+
+    char body[max_body_len];
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "format_int.hpp"
+
+// request bodies built from text that is minified/escaped at compile time
+// %i and %s mark int and string slots, which are the only work left at runtime
+//
+// GRAPHQL_QUERY(text) minifies GraphQL and JSON-escapes it, so it can go inside the "query" string
+// GRAPHQL_JSON(text) is used as-is, for the JSON around the query
+// templates can be joined with +, the largest possible output is max_size
+
+enum class GraphQLSlot : uint8_t
+{
+    Int,
+    String
+};
+
+template<size_t Len, size_t IntSlots, size_t StringSlots>
+struct GraphQLTemplate
+{
+    static constexpr size_t num_slots = IntSlots + StringSlots;
+
+    // longest string slot value, enough for logins and page cursors (which also have to fit in the parser)
+    static constexpr size_t max_string_len = 128;
+
+    static constexpr size_t max_size = Len + IntSlots * format_int_max_len + StringSlots * max_string_len * 2;
+
+    char text[Len + 1]; // fixed parts, one segment before each slot and one after the last
+    size_t segment_end[num_slots + 1];
+    GraphQLSlot slots[num_slots + 1];
+
+    // writes up to max_size bytes, returns the length or 0 if an arg doesn't fit its slot
+    template<class... Args>
+    size_t format(char *out, Args... args) const
+    {
+        static_assert(sizeof...(Args) == num_slots, "wrong number of template args");
+
+        size_t off = 0, slot = 0;
+        bool ok = true;
+
+        // segment then slot, for each arg
+        ((off += copy_segment(out + off, slot), ok = ok && write_slot(out, off, slots[slot], args), slot++), ...);
+
+        off += copy_segment(out + off, slot);
+
+        return ok ? off : 0;
+    }
+
+    constexpr std::string_view getText() const
+    {
+        return {text, Len};
+    }
+
+private:
+    size_t copy_segment(char *out, size_t segment) const
+    {
+        size_t start = segment ? segment_end[segment - 1] : 0;
+        size_t len = segment_end[segment] - start;
+
+        memcpy(out, text + start, len);
+        return len;
+    }
+
+    static bool write_slot(char *out, size_t &off, GraphQLSlot type, int value)
+    {
+        if(type != GraphQLSlot::Int)
+            return false;
+
+        off += format_int(out + off, value);
+        return true;
+    }
+
+    // JSON-escaped, control characters aren't allowed
+    static bool write_slot(char *out, size_t &off, GraphQLSlot type, std::string_view value)
+    {
+        if(type != GraphQLSlot::String || value.length() > max_string_len)
+            return false;
+
+        for(auto c : value)
+        {
+            if(uint8_t(c) < 0x20)
+                return false;
+
+            if(c == '"' || c == '\\')
+                out[off++] = '\\';
+
+            out[off++] = c;
+        }
+
+        return true;
+    }
+};
+
+namespace graphql_template
+{
+    constexpr bool is_ignored(char c)
+    {
+        // commas are insignificant in GraphQL
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == ',';
+    }
+
+    constexpr bool is_name_char(char c)
+    {
+        return c == '_' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    constexpr bool is_slot(std::string_view in, size_t i)
+    {
+        return in[i] == '%' && i + 1 < in.length() && (in[i + 1] == 'i' || in[i + 1] == 's');
+    }
+
+    // runs through the output, calling out.put for each char and out.slot for each slot
+    template<class Out>
+    constexpr void process(std::string_view in, bool minify, Out &out)
+    {
+        bool in_string = false, pending_space = false;
+        char last = 0;
+
+        auto put = [&out, minify](char c)
+        {
+            if(minify && (c == '"' || c == '\\'))
+                out.put('\\');
+            out.put(c);
+        };
+
+        for(size_t i = 0; i < in.length(); i++)
+        {
+            char c = in[i];
+
+            if(is_slot(in, i))
+            {
+                if(pending_space && is_name_char(last))
+                    out.put(' ');
+
+                out.slot(in[++i] == 'i' ? GraphQLSlot::Int : GraphQLSlot::String);
+
+                pending_space = false;
+                last = 'a'; // acts like part of a name
+                continue;
+            }
+
+            if(!minify)
+            {
+                out.put(c);
+                continue;
+            }
+
+            if(in_string)
+            {
+                put(c);
+
+                if(c == '\\' && i + 1 < in.length())
+                    put(in[++i]);
+                else if(c == '"')
+                    in_string = false;
+
+                last = c;
+                continue;
+            }
+
+            if(is_ignored(c))
+            {
+                pending_space = true;
+                continue;
+            }
+
+            // only needed between names/numbers
+            if(pending_space && is_name_char(last) && is_name_char(c))
+                out.put(' ');
+
+            pending_space = false;
+
+            if(c == '"')
+                in_string = true;
+
+            put(c);
+            last = c;
+        }
+    }
+
+    struct Counter
+    {
+        size_t len = 0, slots[2] = {};
+
+        constexpr void put(char) {len++;}
+        constexpr void slot(GraphQLSlot type) {slots[int(type)]++;}
+    };
+
+    constexpr size_t length(std::string_view in, bool minify)
+    {
+        Counter counter;
+        process(in, minify, counter);
+        return counter.len;
+    }
+
+    constexpr size_t slot_count(std::string_view in, bool minify, GraphQLSlot type)
+    {
+        Counter counter;
+        process(in, minify, counter);
+        return counter.slots[int(type)];
+    }
+
+    template<size_t Len, size_t IntSlots, size_t StringSlots>
+    struct Builder
+    {
+        GraphQLTemplate<Len, IntSlots, StringSlots> &ret;
+        size_t len = 0, num_slots = 0;
+
+        constexpr void put(char c)
+        {
+            ret.text[len++] = c;
+        }
+
+        constexpr void slot(GraphQLSlot type)
+        {
+            ret.segment_end[num_slots] = len;
+            ret.slots[num_slots++] = type;
+        }
+    };
+
+    template<size_t Len, size_t IntSlots, size_t StringSlots>
+    constexpr GraphQLTemplate<Len, IntSlots, StringSlots> make(std::string_view in, bool minify)
+    {
+        GraphQLTemplate<Len, IntSlots, StringSlots> ret{};
+        Builder<Len, IntSlots, StringSlots> builder{ret};
+
+        process(in, minify, builder);
+
+        ret.segment_end[builder.num_slots] = Len;
+        return ret;
+    }
+}
+
+#define GRAPHQL_TEMPLATE_(text, minify) graphql_template::make< \
+    graphql_template::length(text, minify), \
+    graphql_template::slot_count(text, minify, GraphQLSlot::Int), \
+    graphql_template::slot_count(text, minify, GraphQLSlot::String)>(text, minify)
+
+#define GRAPHQL_QUERY(text) GRAPHQL_TEMPLATE_(text, true)
+#define GRAPHQL_JSON(text) GRAPHQL_TEMPLATE_(text, false)
+
+template<size_t LenA, size_t IntA, size_t StringA, size_t LenB, size_t IntB, size_t StringB>
+constexpr GraphQLTemplate<LenA + LenB, IntA + IntB, StringA + StringB> operator+(const GraphQLTemplate<LenA, IntA, StringA> &a, const GraphQLTemplate<LenB, IntB, StringB> &b)
+{
+    GraphQLTemplate<LenA + LenB, IntA + IntB, StringA + StringB> ret{};
+
+    for(size_t i = 0; i < LenA; i++)
+        ret.text[i] = a.text[i];
+    for(size_t i = 0; i < LenB; i++)
+        ret.text[LenA + i] = b.text[i];
+
+    // a's last segment runs into b's first
+    for(size_t i = 0; i < a.num_slots; i++)
+    {
+        ret.segment_end[i] = a.segment_end[i];
+        ret.slots[i] = a.slots[i];
+    }
+
+    for(size_t i = 0; i <= b.num_slots; i++)
+    {
+        ret.segment_end[a.num_slots + i] = LenA + b.segment_end[i];
+        ret.slots[a.num_slots + i] = b.slots[i];
+    }
+
+    return ret;
+}
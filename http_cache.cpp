@@ -0,0 +1,272 @@
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+#include "pico/stdlib.h"
+
+#include "http_cache.hpp"
+
+// from Cache-Control, "private, max-age=60, s-maxage=60"
+static bool parse_max_age(std::string_view value, uint32_t &max_age)
+{
+    static constexpr std::string_view directive = "max-age=";
+
+    for(size_t pos = value.find(directive); pos != std::string_view::npos; pos = value.find(directive, pos + 1))
+    {
+        // not s-maxage
+        if(pos && value[pos - 1] != ' ' && value[pos - 1] != ',')
+            continue;
+
+        auto start = value.data() + pos + directive.length();
+        return std::from_chars(start, value.data() + value.length(), max_age).ec == std::errc();
+    }
+
+    return false;
+}
+
+HTTPCache::HTTPCache(HTTPClient &client, KVStore &store) : client(client), store(store)
+{
+}
+
+bool HTTPCache::get(const char *path, BodyFunc on_body, DoneFunc on_done)
+{
+    if(strlen(path) > max_path_len)
+        return false;
+
+    if(busy)
+    {
+        bool joined = flights.join(flights.makeKey("GET", client.getHost(), path), on_done);
+        if(joined)
+            stats.joined++;
+
+        return joined;
+    }
+
+    this->path = path;
+    onBody = on_body;
+    onDone = on_done;
+
+    load();
+
+    auto now = to_ms_since_boot(get_absolute_time());
+
+    auto fresh = fresh_until.find(this->path);
+    if(have_entry && fresh != fresh_until.end() && int32_t(fresh->second - now) > 0)
+    {
+        stats.fresh++;
+
+        if(onDone)
+            onDone(Result::Fresh, result.data(), result.size());
+
+        return true;
+    }
+
+    status = 0;
+    new_etag.clear();
+    new_last_modified.clear();
+    max_age = 0;
+
+    client.setOnStatus([this](int code, std::string_view message)
+    {
+        status = code;
+    });
+
+    client.setOnHeader([this](std::string_view name, std::string_view value)
+    {
+        if(value.length() > max_validator_len)
+            return;
+
+        if(HTTPClient::headerNameEquals(name, "ETag"))
+            new_etag = value;
+        else if(HTTPClient::headerNameEquals(name, "Last-Modified"))
+            new_last_modified = value;
+        else if(HTTPClient::headerNameEquals(name, "Cache-Control"))
+            parse_max_age(value, max_age);
+    });
+
+    client.setOnBodyData([this](unsigned int len, uint8_t *data)
+    {
+        if(status == 200 && onBody)
+            onBody(len, data);
+    });
+
+    client.setOnResponseComplete([this]()
+    {
+        if(status == 304 && have_entry)
+            finish(Result::NotModified);
+        else if(status == 200)
+            finish(Result::Modified);
+        else
+        {
+            printf("%s failed: %i\n", this->path.c_str(), status);
+            finish(Result::Failed);
+        }
+    });
+
+    std::map<std::string_view, std::string_view> headers;
+
+    if(have_entry && !etag.empty())
+        headers.emplace("If-None-Match", etag);
+    if(have_entry && !last_modified.empty())
+        headers.emplace("If-Modified-Since", last_modified);
+
+    if(!client.get(path, headers))
+        return false;
+
+    flights.begin(flights.makeKey("GET", client.getHost(), path), nullptr);
+
+    busy = true;
+    return true;
+}
+
+void HTTPCache::setResult(const void *data, size_t len)
+{
+    StoredHeader header{max_age, uint8_t(new_etag.length()), uint8_t(new_last_modified.length())};
+
+    pending_key = make_key(path);
+
+    pending_value.resize(sizeof(header) + header.etag_len + header.last_modified_len + len);
+    auto out = pending_value.data();
+
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    memcpy(out, new_etag.data(), header.etag_len);
+    out += header.etag_len;
+    memcpy(out, new_last_modified.data(), header.last_modified_len);
+    out += header.last_modified_len;
+
+    if(len)
+        memcpy(out, data, len);
+
+    write_pending = true;
+}
+
+void HTTPCache::update()
+{
+    if(busy && !client.isConnected() && !client.getPendingResponses())
+    {
+        printf("%s lost\n", path.c_str());
+        finish(Result::Failed);
+    }
+
+    // between requests, so nothing's arriving while interrupts are off
+    if(write_pending && !busy && !client.getPendingResponses())
+    {
+        write_pending = false;
+
+        if(!store.put(pending_key, pending_value.data(), pending_value.size()))
+            printf("failed to store %s\n", pending_key.c_str());
+    }
+}
+
+bool HTTPCache::isBusy() const
+{
+    return busy;
+}
+
+const HTTPCache::Stats &HTTPCache::getStats() const
+{
+    return stats;
+}
+
+void HTTPCache::printStats() const
+{
+    printf("http cache: %u fresh, %u not modified, %u modified, %u failed, %u joined\n",
+        stats.fresh, stats.not_modified, stats.modified, stats.failed, stats.joined);
+}
+
+std::string HTTPCache::make_key(std::string_view path)
+{
+    std::string key = "http";
+    key += path;
+    return key;
+}
+
+void HTTPCache::load()
+{
+    have_entry = false;
+    etag.clear();
+    last_modified.clear();
+
+    // a result not written yet is newer than the stored one
+    auto key = make_key(path);
+    bool pending = write_pending && key == pending_key;
+
+    int len = pending ? pending_value.size() : store.getLength(key);
+    if(len < int(sizeof(StoredHeader)))
+        return;
+
+    result.resize(len);
+
+    if(pending)
+        memcpy(result.data(), pending_value.data(), len);
+    else if(store.get(key, result.data(), len) != len)
+        return;
+
+    StoredHeader header;
+    memcpy(&header, result.data(), sizeof(header));
+
+    size_t header_len = sizeof(header) + header.etag_len + header.last_modified_len;
+    if(header_len > size_t(len))
+        return;
+
+    auto validators = reinterpret_cast<const char *>(result.data() + sizeof(header));
+    etag.assign(validators, header.etag_len);
+    last_modified.assign(validators + header.etag_len, header.last_modified_len);
+
+    // just the result
+    result.erase(result.begin(), result.begin() + header_len);
+
+    have_entry = true;
+}
+
+void HTTPCache::finish(Result result)
+{
+    busy = false;
+
+    auto now = to_ms_since_boot(get_absolute_time());
+
+    switch(result)
+    {
+        case Result::Fresh:
+            break;
+
+        case Result::NotModified:
+            stats.not_modified++;
+            fresh_until[path] = now + max_age * 1000;
+            break;
+
+        case Result::Modified:
+            stats.modified++;
+            fresh_until[path] = now + max_age * 1000;
+            break;
+
+        case Result::Failed:
+            stats.failed++;
+            break;
+    }
+
+    auto key = flights.makeKey("GET", client.getHost(), path);
+
+    if(result == Result::Modified || !have_entry)
+    {
+        if(onDone)
+            onDone(result, nullptr, 0);
+
+        // anyone that joined gets whatever the first caller made of the new body
+        bool have_new = result == Result::Modified && write_pending && pending_key == make_key(path);
+        size_t header_len = sizeof(StoredHeader) + new_etag.length() + new_last_modified.length();
+
+        if(have_new)
+            flights.complete(key, result, pending_value.data() + header_len, pending_value.size() - header_len);
+        else
+            flights.complete(key, result, nullptr, 0);
+    }
+    else
+    {
+        if(onDone)
+            onDone(result, this->result.data(), this->result.size());
+
+        flights.complete(key, result, this->result.data(), this->result.size());
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http_client.hpp"
+#include "kv_store.hpp"
+#include "single_flight.hpp"
+
+// conditional GETs for REST endpoints, keeping the validators and the caller's parsed result (not the body) in the store
+// within max-age the stored result is returned without a request, after that it's revalidated with If-None-Match/If-Modified-Since
+// and a 304 (which doesn't count against the rate limit) returns the stored result without the body going near a parser
+// responses need a Content-Length (or no body) so the end can be found
+class HTTPCache final
+{
+public:
+    enum class Result
+    {
+        Fresh, // within max-age, nothing was sent
+        NotModified,
+        Modified, // the new body went to the body callback
+        Failed
+    };
+
+    struct Stats
+    {
+        uint32_t fresh;
+        uint32_t not_modified;
+        uint32_t modified;
+        uint32_t failed;
+        uint32_t joined;
+    };
+
+    using BodyFunc = HTTPClient::BodyFunc;
+
+    // data is the stored result for Fresh/NotModified (and Failed if there is one)
+    // called from the response callback, or straight away if fresh
+    using DoneFunc = std::function<void(Result result, const uint8_t *data, size_t len)>;
+
+    static constexpr size_t max_path_len = 128;
+    static constexpr size_t max_validator_len = 64;
+
+    HTTPCache(HTTPClient &client, KVStore &store);
+
+    // the body callback only gets 200 responses
+    // asking for the URL that's already being fetched waits for that instead (and has no body callback)
+    bool get(const char *path, BodyFunc on_body, DoneFunc on_done);
+
+    // call after a Modified result with what to return next time
+    void setResult(const void *data, size_t len);
+
+    // writes results to the store (not from the response callback, as writing flash stops everything else)
+    // and notices dropped connections, call regularly
+    void update();
+
+    bool isBusy() const;
+
+    const Stats &getStats() const;
+    void printStats() const;
+
+private:
+    struct StoredHeader
+    {
+        uint32_t max_age; // seconds
+        uint8_t etag_len;
+        uint8_t last_modified_len;
+    };
+
+    static std::string make_key(std::string_view path);
+
+    void load();
+    void finish(Result result);
+
+    HTTPClient &client;
+    KVStore &store;
+
+    bool busy = false;
+    std::string path;
+
+    BodyFunc onBody;
+    DoneFunc onDone;
+
+    // stored for path
+    bool have_entry = false;
+    std::string etag, last_modified;
+    std::vector<uint8_t> result;
+
+    // from the response
+    int status = 0;
+    std::string new_etag, new_last_modified;
+    uint32_t max_age = 0;
+
+    SingleFlight<Result, const uint8_t *, size_t> flights;
+
+    bool write_pending = false;
+    std::string pending_key;
+    std::vector<uint8_t> pending_value;
+
+    // ms since boot that each path can be used until without revalidating, not kept across reboots
+    std::map<std::string, uint32_t, std::less<>> fresh_until;
+
+    Stats stats = {};
+};
@@ -1,13 +1,20 @@
 #include <charconv>
+#include <climits>
+#include <cstring>
 
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
 
+#include "lwip/altcp_tls.h"
 #include "lwip/dns.h"
 
+#include "format_int.hpp"
 #include "http_client.hpp"
 
-HTTPClient::HTTPClient(const char *host, altcp_allocator_t *altcp_allocator) : host(host), altcp_allocator(altcp_allocator){}
+HTTPClient::HTTPClient(const char *host, altcp_allocator_t *altcp_allocator) : host(host), altcp_allocator(altcp_allocator)
+{
+    setDefaultHeaders({});
+}
 
 bool HTTPClient::get(const char *path, std::map<std::string_view, std::string_view> headers)
 {
@@ -22,11 +29,7 @@ bool HTTPClient::post(const char *path, std::string_view body, std::map<std::str
     if(!connect())
         return false;
 
-    // set Content-Length
-    std::string len = std::to_string(body.length());
-    headers["Content-Length"] = len;
-
-    if(!do_request("POST", path, headers))
+    if(!do_request("POST", path, headers, body.length()))
         return false;
 
     cyw43_arch_lwip_begin();
@@ -36,6 +39,22 @@ bool HTTPClient::post(const char *path, std::string_view body, std::map<std::str
     return true;
 }
 
+void HTTPClient::setDefaultHeaders(std::map<std::string_view, std::string_view> headers)
+{
+    // these don't change between requests, so only format them once
+    default_headers = "Host: ";
+    default_headers += host;
+    default_headers += "\r\n";
+
+    for(auto &header : headers)
+    {
+        default_headers += header.first;
+        default_headers += ": ";
+        default_headers += header.second;
+        default_headers += "\r\n";
+    }
+}
+
 void HTTPClient::setOnStatus(StatusFunc fun)
 {
     onStatus = fun;
@@ -51,29 +70,91 @@ void HTTPClient::setOnBodyData(BodyFunc fun)
     onBodyData = fun;
 }
 
-bool HTTPClient::connect()
+void HTTPClient::setOnResponseComplete(CompleteFunc fun)
+{
+    onResponseComplete = fun;
+}
+
+bool HTTPClient::prewarm()
+{
+    return start_connect();
+}
+
+void HTTPClient::setIdleTimeout(uint32_t timeout_ms)
+{
+    idle_timeout = timeout_ms;
+}
+
+void HTTPClient::update()
+{
+    // a slow response (or a pipelined one that hasn't started) isn't idle
+    if(!connected || !idle_timeout || pending_responses)
+        return;
+
+    auto now = to_ms_since_boot(get_absolute_time());
+
+    if(now - last_activity_time > idle_timeout)
+    {
+        printf("closing idle connection\n");
+
+        cyw43_arch_lwip_begin();
+        disconnect();
+        cyw43_arch_lwip_end();
+    }
+}
+
+bool HTTPClient::isConnected() const
+{
+    return connected;
+}
+
+const char *HTTPClient::getHost() const
+{
+    return host;
+}
+
+int HTTPClient::getPendingResponses() const
 {
-    if(connected)
+    return pending_responses;
+}
+
+bool HTTPClient::start_connect()
+{
+    // already connected or connecting
+    if(connected || pcb || dns_pending)
         return true;
 
-    err_t err;
+    connect_start_time = to_ms_since_boot(get_absolute_time());
 
     // DNS lookup
     if(!done_addr_lookup)
     {
-        err = dns_gethostbyname(host, &remote_addr, static_dns_found, this);
+        cyw43_arch_lwip_begin();
+        err_t err = dns_gethostbyname(host, &remote_addr, static_dns_found, this);
+        cyw43_arch_lwip_end();
 
         if(err == ERR_OK)
             done_addr_lookup = true;
         else if(err == ERR_INPROGRESS)
         {
-            // wait for it
-            // TODO: avoid blocking?
-            while(!done_addr_lookup)
-                sleep_ms(1);
+            // continues in on_dns_found
+            dns_pending = true;
+            return true;
+        }
+        else
+        {
+            printf("dns lookup failed %i\n", err);
+            return false;
         }
     }
 
+    return open_connection();
+}
+
+bool HTTPClient::open_connection()
+{
+    cyw43_arch_lwip_begin();
+
     pcb = altcp_new_ip_type(altcp_allocator, IP_GET_TYPE(&remote_addr));
 
     altcp_arg(pcb,this);
@@ -81,11 +162,19 @@ bool HTTPClient::connect()
     altcp_sent(pcb, static_sent);
     altcp_err(pcb, static_error);
 
-    cyw43_arch_lwip_begin();
-
     // TODO: assuming allocator is TLS allocator
     bool is_tls = altcp_allocator != nullptr;
-    err = altcp_connect(pcb, &remote_addr, is_tls ? 443 : 80, static_connected);
+
+    // offer the last session, the server can skip the key exchange if it still has it
+    resuming_session = is_tls && tls_session && altcp_tls_set_session(pcb, tls_session) == ERR_OK;
+
+    err_t err = altcp_connect(pcb, &remote_addr, is_tls ? 443 : 80, static_connected);
+
+    if(err != ERR_OK)
+    {
+        altcp_abort(pcb);
+        pcb = nullptr;
+    }
 
     cyw43_arch_lwip_end();
 
@@ -95,12 +184,20 @@ bool HTTPClient::connect()
         return false;
     }
 
+    return true;
+}
+
+bool HTTPClient::connect()
+{
+    if(!start_connect())
+        return false;
+
     // wait
-    // TODO:?
-    while(!connected && pcb)
+    // TODO: avoid blocking?
+    while(!connected && (dns_pending || pcb))
         sleep_ms(1);
 
-    if(!pcb)
+    if(!connected)
     {
         printf("tcp_connect failed\n");
         return false;
@@ -121,29 +218,70 @@ err_t HTTPClient::disconnect()
     pcb = nullptr;
     connected = false;
 
+    // anything still pending is lost
+    pending_responses = 0;
+    res_state = ResponseState::Status;
+    temp_header.clear();
+
     return ret;
 }
 
-bool HTTPClient::do_request(const char *method, const char *path, const std::map<std::string_view, std::string_view> &headers)
+bool HTTPClient::do_request(const char *method, const char *path, const std::map<std::string_view, std::string_view> &headers, int content_length)
 {
     char buf[1024];
-    int off = snprintf(buf, sizeof(buf), "%s %s HTTP/1.1\r\nHost: %s\r\n", method, path, host);
+    size_t off = 0;
+    bool overflow = false;
+
+    auto append = [&buf, &off, &overflow](std::string_view str)
+    {
+        if(off + str.length() > sizeof(buf))
+        {
+            overflow = true;
+            return;
+        }
+
+        memcpy(buf + off, str.data(), str.length());
+        off += str.length();
+    };
+
+    append(method);
+    append(" ");
+    append(path);
+    append(" HTTP/1.1\r\n");
+    append(default_headers);
 
-    // headers
+    // per-request headers
     for(auto &header : headers)
-        off += snprintf(buf + off, sizeof(buf) - off, "%.*s: %.*s\r\n", header.first.length(), header.first.data(), header.second.length(), header.second.data());
+    {
+        append(header.first);
+        append(": ");
+        append(header.second);
+        append("\r\n");
+    }
 
-    if(off >= sizeof(buf) - 3)
-        return false;
+    if(content_length >= 0)
+    {
+        char len_buf[format_int_max_len];
+        append("Content-Length: ");
+        append({len_buf, format_uint(len_buf, content_length)});
+        append("\r\n");
+    }
 
-    buf[off++] = '\r';
-    buf[off++] = '\n';
-    buf[off] = 0;
+    append("\r\n");
 
-    res_state = ResponseState::Status;
+    if(overflow)
+        return false;
+
+    last_activity_time = to_ms_since_boot(get_absolute_time());
 
     cyw43_arch_lwip_begin();
-    altcp_write(pcb, buf, strlen(buf), TCP_WRITE_FLAG_COPY);
+
+    // pipelined behind another request, its response comes first
+    if(!pending_responses)
+        res_state = ResponseState::Status;
+
+    pending_responses++;
+    altcp_write(pcb, buf, off, TCP_WRITE_FLAG_COPY);
     cyw43_arch_lwip_end();
 
     return true;
@@ -151,8 +289,18 @@ bool HTTPClient::do_request(const char *method, const char *path, const std::map
 
 void HTTPClient::on_dns_found(const char *name, const ip_addr_t *ipAddr)
 {
+    if(!ipAddr)
+    {
+        printf("dns lookup failed for %s\n", name);
+        dns_pending = false;
+        return;
+    }
+
     remote_addr = *ipAddr;
     done_addr_lookup = true;
+
+    open_connection();
+    dns_pending = false;
 }
 
 err_t HTTPClient::on_connected(struct altcp_pcb *pcb, err_t err)
@@ -161,17 +309,42 @@ err_t HTTPClient::on_connected(struct altcp_pcb *pcb, err_t err)
         return disconnect();
 
     connected = true;
+    last_activity_time = to_ms_since_boot(get_absolute_time());
+
+    printf("connected in %i ms%s\n", last_activity_time - connect_start_time, resuming_session ? " (resumed session offered)" : "");
+
+    // keep the session (and ticket) for next time
+    if(altcp_allocator)
+    {
+        if(!tls_session)
+            tls_session = altcp_tls_alloc_session();
+
+        if(tls_session && altcp_tls_get_session(pcb, tls_session) != ERR_OK)
+        {
+            altcp_tls_free_session(tls_session);
+            tls_session = nullptr;
+        }
+    }
+
     return ERR_OK;
 }
 
 err_t HTTPClient::on_received(struct altcp_pcb *pcb, struct pbuf *buf, err_t err)
 {
     if(!buf)
+    {
+        // the body ends with the connection if there's nothing else to go by
+        if(res_state == ResponseState::Body && body_remaining < 0)
+            complete_response();
+
         return disconnect();
+    }
 
     cyw43_arch_lwip_check();
     if(buf->tot_len)
     {
+        last_activity_time = to_ms_since_boot(get_absolute_time());
+
         // TODO: parse
         for(auto buffer = buf; buffer; buffer = buffer->next)
         {
@@ -183,53 +356,51 @@ err_t HTTPClient::on_received(struct altcp_pcb *pcb, struct pbuf *buf, err_t err
                 {
                     case ResponseState::Status:
                     {
-                        auto end = str.find("\r\n");
-                        // TODO: should handle not finding end
-                        auto line = str.substr(0, end);
+                        std::string_view line;
+                        if(!read_line(str, off, line))
+                            continue;
 
                         // extract code/message
+                        int code = 0;
+                        auto space = line.find_first_of(' ');
+                        std::from_chars(line.data() + space + 1, line.data() + line.length(), code);
+
                         if(onStatus)
                         {
-                            int code = 0;
-                            auto space = line.find_first_of(' ');
-                            std::from_chars(line.data() + space + 1, line.data() + line.length(), code);
-
                             space = line.find_first_of(' ', space + 1);
                             auto message = line.substr(space + 1);
 
                             onStatus(code, message);
                         }
 
-                        off += end + 2;
+                        temp_header.clear();
+
                         res_state = ResponseState::Headers;
+                        body_remaining = -1;
+                        chunked = false;
+
+                        // never have a body, whatever the headers say
+                        no_body = code == 204 || code == 304;
                         break;
                     }
 
                     case ResponseState::Headers:
                     {
-                        auto end = str.find("\r\n");
-
-                        if(end == std::string_view::npos)
-                        {
-                            // need more data
-                            temp_header += str;
-                            off = buffer->len;
+                        std::string_view line;
+                        if(!read_line(str, off, line))
                             continue;
-                        }
 
-                        // get full header line
-                        std::string_view line;
-                        if(temp_header.empty())
-                            line = str.substr(0, end);
-                        else
+                        if(line.empty())
                         {
-                            temp_header += str.substr(0, end);
-                            line = temp_header;
-                        }
+                            res_state = chunked && !no_body ? ResponseState::ChunkSize : ResponseState::Body;
+
+                            if(no_body)
+                                body_remaining = 0;
 
-                        if(end == 0)
-                            res_state = ResponseState::Body;
-                        else if(onHeader)
+                            if(body_remaining == 0 && res_state == ResponseState::Body)
+                                complete_response();
+                        }
+                        else
                         {
                             auto colon = line.find_first_of(':');
                             auto name = line.substr(0, colon);
@@ -237,21 +408,107 @@ err_t HTTPClient::on_received(struct altcp_pcb *pcb, struct pbuf *buf, err_t err
                             if(value[0] == ' ')
                                 value.remove_prefix(1);
 
-                            onHeader(name, value);
+                            // needed to find the end of the body, so the next pipelined response can start
+                            if(headerNameEquals(name, "Content-Length"))
+                                std::from_chars(value.data(), value.data() + value.length(), body_remaining);
+
+                            // the only coding that's sent without asking for it
+                            if(headerNameEquals(name, "Transfer-Encoding") && value.find("chunked") != std::string_view::npos)
+                            {
+                                chunked = true;
+                                body_remaining = -1;
+                            }
 
-                            if(!temp_header.empty())
-                                temp_header.clear();
+                            if(onHeader)
+                                onHeader(name, value);
                         }
-                        off += end + 2;
+
+                        temp_header.clear();
 
                         break;
                     }
 
                     case ResponseState::Body:
+                    case ResponseState::ChunkData:
+                    {
+                        // without a length, everything is body until the connection closes
+                        unsigned int len = buffer->len - off;
+                        if(body_remaining >= 0 && len > unsigned(body_remaining))
+                            len = body_remaining;
+
                         if(onBodyData)
-                            onBodyData(buffer->len - off, reinterpret_cast<uint8_t *>(buffer->payload) + off);
+                            onBodyData(len, reinterpret_cast<uint8_t *>(buffer->payload) + off);
+
+                        off += len;
+
+                        if(body_remaining >= 0)
+                        {
+                            body_remaining -= len;
+
+                            if(body_remaining == 0)
+                            {
+                                if(res_state == ResponseState::ChunkData)
+                                    res_state = ResponseState::ChunkEnd;
+                                else
+                                    complete_response();
+                            }
+                        }
+                        break;
+                    }
+
+                    case ResponseState::ChunkSize:
+                    {
+                        std::string_view line;
+                        if(!read_line(str, off, line))
+                            continue;
+
+                        // hex, possibly followed by ;extensions
+                        unsigned int size = 0;
+                        auto res = std::from_chars(line.data(), line.data() + line.length(), size, 16);
+                        temp_header.clear();
 
-                        off = buffer->len;
+                        if(res.ec != std::errc() || size > INT_MAX)
+                        {
+                            printf("bad chunk size\n");
+                            complete_response();
+                            break;
+                        }
+
+                        // the last chunk is empty, then there may be trailers
+                        if(size == 0)
+                            res_state = ResponseState::Trailers;
+                        else
+                        {
+                            body_remaining = size;
+                            res_state = ResponseState::ChunkData;
+                        }
+                        break;
+                    }
+
+                    case ResponseState::ChunkEnd:
+                    {
+                        std::string_view line;
+                        if(!read_line(str, off, line))
+                            continue;
+
+                        temp_header.clear();
+                        res_state = ResponseState::ChunkSize;
+                        break;
+                    }
+
+                    case ResponseState::Trailers:
+                    {
+                        std::string_view line;
+                        if(!read_line(str, off, line))
+                            continue;
+
+                        bool end = line.empty();
+                        temp_header.clear();
+
+                        if(end)
+                            complete_response();
+                        break;
+                    }
                 }
             }
         }
@@ -263,6 +520,65 @@ err_t HTTPClient::on_received(struct altcp_pcb *pcb, struct pbuf *buf, err_t err
     return ERR_OK;
 }
 
+void HTTPClient::complete_response()
+{
+    res_state = ResponseState::Status;
+
+    if(pending_responses)
+        pending_responses--;
+
+    if(onResponseComplete)
+        onResponseComplete();
+}
+
+bool HTTPClient::read_line(std::string_view str, unsigned int &off, std::string_view &line)
+{
+    auto end = str.find("\r\n");
+
+    // CR at the end of the last buffer
+    if(!temp_header.empty() && temp_header.back() == '\r' && !str.empty() && str[0] == '\n')
+    {
+        temp_header.pop_back();
+        line = temp_header;
+        off += 1;
+        return true;
+    }
+
+    if(end == std::string_view::npos)
+    {
+        // need more data
+        temp_header += str;
+        off += str.length();
+        return false;
+    }
+
+    if(temp_header.empty())
+        line = str.substr(0, end);
+    else
+    {
+        temp_header += str.substr(0, end);
+        line = temp_header;
+    }
+
+    off += end + 2;
+    return true;
+}
+
+bool HTTPClient::headerNameEquals(std::string_view name, std::string_view expected)
+{
+    if(name.length() != expected.length())
+        return false;
+
+    // case-insensitive, at least for ASCII letters
+    for(size_t i = 0; i < name.length(); i++)
+    {
+        if((name[i] | 0x20) != (expected[i] | 0x20))
+            return false;
+    }
+
+    return true;
+}
+
 err_t HTTPClient::on_sent(struct altcp_pcb *pcb, u16_t len)
 {
     // TODO: something
@@ -272,8 +588,9 @@ err_t HTTPClient::on_sent(struct altcp_pcb *pcb, u16_t len)
 
 void HTTPClient::on_error(err_t err)
 {
-    if(err != ERR_ABRT)
-        disconnect();
+    // the pcb has already been freed
+    pcb = nullptr;
+    disconnect();
 }
 
 void HTTPClient::static_dns_found(const char *name, const ip_addr_t *ipAddr, void *arg)
@@ -14,28 +14,68 @@ public:
     using StatusFunc = std::function<void(int, std::string_view)>;
     using HeaderFunc = std::function<void(std::string_view, std::string_view)>;
     using BodyFunc = std::function<void(unsigned int, uint8_t *)>;
+    using CompleteFunc = std::function<void()>;
 
     HTTPClient(const char *host, altcp_allocator_t *altcp_allocator = nullptr);
 
     bool get(const char *path, std::map<std::string_view, std::string_view> headers = {});
     bool post(const char *path, std::string_view body, std::map<std::string_view, std::string_view> headers = {});
 
+    // sent with every request, along with Host
+    void setDefaultHeaders(std::map<std::string_view, std::string_view> headers);
+
     void setOnStatus(StatusFunc fun);
     void setOnHeader(HeaderFunc fun);
     void setOnBodyData(BodyFunc fun);
 
+    // called after the last of the body (decoded if chunked)
+    // for responses with neither a Content-Length nor chunked encoding, that's when the server closes the connection
+    void setOnResponseComplete(CompleteFunc fun);
+
+    // starts connecting (DNS, TCP and TLS) without waiting, so the next request can be sent straight away
+    bool prewarm();
+
+    // close the connection after this long without any traffic and no responses pending, 0 to keep it open
+    void setIdleTimeout(uint32_t timeout_ms);
+
+    // handles the idle timeout, call regularly
+    void update();
+
+    bool isConnected() const;
+
+    const char *getHost() const;
+
+    // requests sent without a complete response yet, more than one when pipelining
+    int getPendingResponses() const;
+
+    // header names are case-insensitive
+    static bool headerNameEquals(std::string_view name, std::string_view expected);
+
 private:
     enum class ResponseState
     {
         Status = 0,
         Headers,
-        Body
+        Body,
+
+        // Transfer-Encoding: chunked
+        ChunkSize,
+        ChunkData,
+        ChunkEnd, // the CRLF after the data
+        Trailers
     };
 
+    bool start_connect();
+    bool open_connection();
     bool connect();
     err_t disconnect();
 
-    bool do_request(const char *method, const char *path, const std::map<std::string_view, std::string_view> &headers);
+    bool do_request(const char *method, const char *path, const std::map<std::string_view, std::string_view> &headers, int content_length = -1);
+
+    void complete_response();
+
+    // a line from str (starting at off), buffered in temp_header if it's split, false if there isn't a whole one yet
+    bool read_line(std::string_view str, unsigned int &off, std::string_view &line);
 
     void on_dns_found(const char *name, const ip_addr_t *ipAddr);
 
@@ -54,19 +94,35 @@ private:
 
     const char *host;
 
+    std::string default_headers; // preformatted
+
     altcp_allocator_t *altcp_allocator;
 
     bool connected = false;
+    bool dns_pending = false;
+
+    uint32_t connect_start_time = 0;
+    uint32_t last_activity_time = 0;
+    uint32_t idle_timeout = 0;
 
     StatusFunc onStatus;
     HeaderFunc onHeader;
     BodyFunc onBodyData;
+    CompleteFunc onResponseComplete;
 
     ResponseState res_state = ResponseState::Status;
+    int body_remaining = -1; // -1 if unknown, in the current chunk if chunked
+    bool no_body = false;
+    bool chunked = false;
+    int pending_responses = 0;
 
     ip_addr_t remote_addr = {};
     altcp_pcb *pcb = nullptr;
     bool done_addr_lookup = false;
 
     std::string temp_header;
+
+    // saved after a full handshake so the next connection can do an abbreviated one
+    struct altcp_tls_session *tls_session = nullptr;
+    bool resuming_session = false;
 };
\ No newline at end of file
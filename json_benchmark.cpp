@@ -0,0 +1,347 @@
+#include <cstdio>
+#include <string>
+
+#include "pico/stdlib.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#endif
+
+#include "tiny-json.h"
+
+#include "contribution_level.hpp"
+#include "json_path.hpp"
+#include "json_scan.hpp"
+#include "json_stream.hpp"
+
+// compares response parsing approaches on a year of contributions in the same format the API returns
+// on the host (PICO_PLATFORM=host) it can also run on recorded responses, given as files on the command line
+// (from a contributionsCollection { contributionCalendar { weeks { contributionDays { contributionLevel } } } } query)
+
+static constexpr int iterations = 20;
+
+// roughly what lwIP hands us per pbuf
+static constexpr size_t chunk_size = 1460;
+
+static const char *level_names[]{"NONE", "FIRST_QUARTILE", "SECOND_QUARTILE", "THIRD_QUARTILE", "FOURTH_QUARTILE"};
+
+static json_t json_mem[1024];
+
+// times are reported in cycles on the device, ns on the host
+#if PICO_ON_DEVICE
+static const char *time_unit = "cycles";
+
+static float units_per_us()
+{
+    return clock_get_hz(clk_sys) / 1000000;
+}
+#else
+static const char *time_unit = "ns";
+
+static float units_per_us()
+{
+    return 1000.0f;
+}
+#endif
+
+static std::string make_response(int first_week_days, int num_days)
+{
+    std::string ret = R"({"data":{"user":{"contributionsCollection":{"contributionCalendar":{"weeks":[)";
+
+    uint32_t seed = 1234;
+    int week_day = 7 - first_week_days;
+
+    for(int day = 0; day < num_days; day++, week_day++)
+    {
+        if(week_day == 7 || day == 0)
+        {
+            if(day != 0)
+                ret += "]},";
+
+            ret += R"({"contributionDays":[)";
+            week_day %= 7;
+        }
+        else
+            ret += ",";
+
+        seed = seed * 1103515245 + 12345;
+
+        ret += R"({"contributionLevel":")";
+        ret += level_names[(seed >> 16) % 5];
+        ret += R"("})";
+    }
+
+    ret += "]}]}}}}}";
+    return ret;
+}
+
+static int level_from_string(std::string_view level)
+{
+    if(level == "FIRST_QUARTILE")
+        return 1;
+    else if(level == "SECOND_QUARTILE")
+        return 2;
+    else if(level == "THIRD_QUARTILE")
+        return 3;
+    else if(level == "FOURTH_QUARTILE")
+        return 4;
+
+    return 0;
+}
+
+// the old approach, buffer everything and build a tree
+static int parse_tiny_json(std::string &str)
+{
+    auto json = json_create(str.data(), json_mem, std::size(json_mem));
+    if(!json)
+        return -1;
+
+    for(auto name : {"data", "user", "contributionsCollection", "contributionCalendar", "weeks"})
+    {
+        json = json_getProperty(json, name);
+        if(!json)
+            return -1;
+    }
+
+    int sum = 0;
+
+    for(auto week = json_getChild(json); week; week = json_getSibling(week))
+    {
+        auto days = json_getProperty(week, "contributionDays");
+        if(!days)
+            continue;
+
+        for(auto day = json_getChild(days); day; day = json_getSibling(day))
+            sum += level_from_string(json_getPropertyValue(day, "contributionLevel"));
+    }
+
+    return sum;
+}
+
+static int parse_stream(const std::string &str)
+{
+    JSONStreamParser parser;
+    int sum = 0;
+
+    parser.setOnEvent([&parser, &sum](JSONStreamParser::Event event, std::string_view value)
+    {
+        if(event == JSONStreamParser::Event::String && parser.getDepth() == 9 && parser.getKey(8) == "contributionLevel")
+            sum += level_from_string(value);
+    });
+
+    auto data = reinterpret_cast<const uint8_t *>(str.data());
+
+    for(size_t off = 0; off < str.length(); off += chunk_size)
+        parser.feed(data + off, std::min(chunk_size, str.length() - off));
+
+    return parser.isDone() ? sum : -1;
+}
+
+static constexpr auto level_path = json_path("data", "user", "contributionsCollection", "contributionCalendar", "weeks", json_each, "contributionDays", json_each, "contributionLevel");
+
+static int parse_stream_paths(const std::string &str)
+{
+    JSONStreamParser parser;
+    JSONPathMatcher matcher(parser);
+    int sum = 0;
+
+    matcher.on(level_path, [&sum](JSONStreamParser::Event event, std::string_view value)
+    {
+        sum += int(contribution_level_from_string(value));
+    });
+
+    auto data = reinterpret_cast<const uint8_t *>(str.data());
+
+    for(size_t off = 0; off < str.length(); off += chunk_size)
+        parser.feed(data + off, std::min(chunk_size, str.length() - off));
+
+    return parser.isDone() ? sum : -1;
+}
+
+// level decoding on its own, string compares vs looking at one byte
+static void bench_levels()
+{
+    static constexpr int num_days = 371;
+    static constexpr int level_iterations = 100;
+
+    std::string_view days[num_days];
+
+    uint32_t seed = 1234;
+    for(auto &day : days)
+    {
+        seed = seed * 1103515245 + 12345;
+        day = level_names[(seed >> 16) % 5];
+    }
+
+    // volatile to stop the loops being optimised out
+    volatile int sum = 0;
+
+    auto start = time_us_64();
+    for(int i = 0; i < level_iterations; i++)
+    {
+        for(auto &day : days)
+            sum = sum + level_from_string(day);
+    }
+    auto compare_time = time_us_64() - start;
+
+    start = time_us_64();
+    for(int i = 0; i < level_iterations; i++)
+    {
+        for(auto &day : days)
+            sum = sum + int(contribution_level_from_string(day));
+    }
+    auto decode_time = time_us_64() - start;
+
+    float scale = units_per_us();
+
+    printf("level strings (%i days): compare %.1f %s/day, byte decode %.1f %s/day\n", num_days,
+        compare_time * scale / (num_days * level_iterations), time_unit,
+        decode_time * scale / (num_days * level_iterations), time_unit);
+}
+
+// finding structural characters a byte at a time vs a word at a time
+static void bench_scan(const std::string &str)
+{
+    static constexpr int scan_iterations = 20;
+
+    auto data = reinterpret_cast<const uint8_t *>(str.data());
+    auto len = str.length();
+
+    volatile int count = 0;
+
+    auto start = time_us_64();
+    for(int i = 0; i < scan_iterations; i++)
+    {
+        for(size_t off = 0; off < len; off++)
+        {
+            char c = data[off];
+            if(c == '"' || c == '\\' || c == '{' || c == '}' || c == '[' || c == ']')
+                count = count + 1;
+        }
+    }
+    auto byte_time = time_us_64() - start;
+    int byte_count = count / scan_iterations;
+
+    count = 0;
+
+    start = time_us_64();
+    for(int i = 0; i < scan_iterations; i++)
+    {
+        for(size_t off = json_scan::find_structural(data, len); off < len; off += json_scan::find_structural(data + off + 1, len - off - 1) + 1)
+            count = count + 1;
+    }
+    auto word_time = time_us_64() - start;
+
+    float scale = units_per_us();
+
+    printf("structural scan (%i found): byte loop %.2f %s/byte, word at a time %.2f %s/byte\n", byte_count,
+        byte_time * scale / (len * scan_iterations), time_unit,
+        word_time * scale / (len * scan_iterations), time_unit);
+}
+
+#if !PICO_ON_DEVICE
+static bool load_response(const char *filename, std::string &response)
+{
+    auto file = fopen(filename, "rb");
+    if(!file)
+        return false;
+
+    char buf[4096];
+    size_t len;
+
+    response.clear();
+
+    while((len = fread(buf, 1, sizeof(buf), file)) > 0)
+        response.append(buf, len);
+
+    fclose(file);
+    return true;
+}
+#endif
+
+static void run_benchmarks(const std::string &response)
+{
+    printf("Response: %u bytes\n\n", response.length());
+
+    // tiny-json modifies the string, so time a copy each time
+    int sum = 0;
+    uint64_t time = 0;
+
+    for(int i = 0; i < iterations; i++)
+    {
+        std::string copy = response;
+
+        auto start = time_us_64();
+        sum = parse_tiny_json(copy);
+        time += time_us_64() - start;
+    }
+
+    printf("tiny-json: %u us/parse, result %i\n", uint32_t(time / iterations), sum);
+    printf("  memory: %u (body) + %u (nodes)\n\n", response.length(), sizeof(json_mem));
+
+    time = 0;
+
+    for(int i = 0; i < iterations; i++)
+    {
+        auto start = time_us_64();
+        sum = parse_stream(response);
+        time += time_us_64() - start;
+    }
+
+    printf("stream: %u us/parse (%u byte chunks), result %i\n", uint32_t(time / iterations), chunk_size, sum);
+    printf("  memory: %u (parser)\n\n", sizeof(JSONStreamParser));
+
+    time = 0;
+
+    for(int i = 0; i < iterations; i++)
+    {
+        auto start = time_us_64();
+        sum = parse_stream_paths(response);
+        time += time_us_64() - start;
+    }
+
+    printf("stream + path matcher: %u us/parse, result %i\n", uint32_t(time / iterations), sum);
+    printf("  memory: %u (parser) + %u (matcher)\n\n", sizeof(JSONStreamParser), sizeof(JSONPathMatcher));
+
+    bench_levels();
+    bench_scan(response);
+}
+
+int main(int argc, char *argv[])
+{
+    stdio_init_all();
+
+#if PICO_ON_DEVICE
+    while(!stdio_usb_connected())
+        sleep_ms(100);
+#else
+    if(argc > 1)
+    {
+        std::string response;
+
+        for(int i = 1; i < argc; i++)
+        {
+            if(!load_response(argv[i], response))
+            {
+                printf("failed to read %s\n", argv[i]);
+                return 1;
+            }
+
+            printf("%s:\n", argv[i]);
+            run_benchmarks(response);
+            printf("\n");
+        }
+
+        return 0;
+    }
+#endif
+
+    run_benchmarks(make_response(6, 365));
+
+#if PICO_ON_DEVICE
+    while(true)
+        sleep_ms(1000);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <charconv>
+
+#include "json_path.hpp"
+
+JSONPathMatcher::JSONPathMatcher(JSONStreamParser &parser) : parser(parser)
+{
+    parser.setOnEvent([this](Event event, std::string_view value)
+    {
+        on_event(event, value);
+    });
+
+    live[0] = 0;
+}
+
+void JSONPathMatcher::clear()
+{
+    num_bindings = 0;
+    live[0] = 0;
+}
+
+int JSONPathMatcher::getEachIndex(int n) const
+{
+    if(!current)
+        return -1;
+
+    for(int i = 0; i < current->len; i++)
+    {
+        if(current->frames[i].any_index && n-- == 0)
+            return parser.getIndex(i);
+    }
+
+    return -1;
+}
+
+std::string_view JSONPathMatcher::getAnyKey(int n) const
+{
+    if(!current)
+        return {};
+
+    for(int i = 0; i < current->len; i++)
+    {
+        if(current->frames[i].any_key && n-- == 0)
+            return parser.getKey(i);
+    }
+
+    return {};
+}
+
+bool JSONPathMatcher::add_binding(const JSONPathFrame *frames, int len, ValueFunc fun)
+{
+    if(num_bindings == max_paths)
+        return false;
+
+    bindings[num_bindings] = {frames, len, fun};
+    live[0] |= 1 << num_bindings;
+    num_bindings++;
+
+    return true;
+}
+
+void JSONPathMatcher::on_event(Event event, std::string_view value)
+{
+    int depth = parser.getDepth();
+    uint32_t mask = match_current(depth);
+
+    bool is_start = event == Event::ObjectStart || event == Event::ArrayStart;
+
+    // nothing can match inside this, don't bother parsing it
+    if(is_start && !mask)
+    {
+        parser.skipValue();
+        return;
+    }
+
+    for(int i = 0; i < num_bindings; i++)
+    {
+        if((mask & (1 << i)) && bindings[i].len == depth)
+        {
+            current = &bindings[i];
+            current->fun(event, value);
+        }
+    }
+
+    current = nullptr;
+
+    if(is_start)
+        live[depth] = mask;
+}
+
+// the bindings that match the current path, which is the parent's with one more frame
+uint32_t JSONPathMatcher::match_current(int depth) const
+{
+    if(depth == 0)
+        return live[0];
+
+    int frame = depth - 1;
+    auto key = parser.getKey(frame);
+    auto index = parser.getIndex(frame);
+
+    uint32_t mask = live[frame];
+    uint32_t ret = 0;
+
+    for(int i = 0; mask; i++, mask >>= 1)
+    {
+        if(!(mask & 1) || frame >= bindings[i].len)
+            continue;
+
+        auto &expected = bindings[i].frames[frame];
+
+        if(expected.any_index ? index >= 0 : index < 0 && (expected.any_key || expected.key == key))
+            ret |= 1 << i;
+    }
+
+    return ret;
+}
+
+void JSONPathMatcher::set_value(Event event, std::string_view str, int &value)
+{
+    if(event == Event::Number)
+        std::from_chars(str.data(), str.data() + str.length(), value);
+}
+
+void JSONPathMatcher::set_value(Event event, std::string_view, bool &value)
+{
+    if(event == Event::True || event == Event::False)
+        value = event == Event::True;
+}
+
+void JSONPathMatcher::set_value(Event event, std::string_view str, std::string &value)
+{
+    if(event == Event::String)
+        value = str;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "json_stream.hpp"
+
+// paths to values in a response, declared at compile time
+// json_path("data", "items", json_each, "name") matches data.items[n].name
+// json_path("data", json_any_key, "name") matches data.*.name, for aliased GraphQL fields
+
+struct JSONPathEach {};
+static constexpr JSONPathEach json_each;
+
+struct JSONPathAnyKey {};
+static constexpr JSONPathAnyKey json_any_key;
+
+struct JSONPathFrame
+{
+    constexpr JSONPathFrame() : key(), any_index(false), any_key(false){}
+    constexpr JSONPathFrame(const char *key) : key(key), any_index(false), any_key(false){}
+    constexpr JSONPathFrame(JSONPathEach) : key(), any_index(true), any_key(false){}
+    constexpr JSONPathFrame(JSONPathAnyKey) : key(), any_index(false), any_key(true){}
+
+    std::string_view key;
+    bool any_index;
+    bool any_key;
+};
+
+template<size_t N>
+struct JSONPath
+{
+    JSONPathFrame frames[N];
+};
+
+template<class... Frames>
+constexpr JSONPath<sizeof...(Frames)> json_path(Frames... frames)
+{
+    return {{JSONPathFrame(frames)...}};
+}
+
+template<size_t N, size_t M>
+constexpr JSONPath<N + M> operator+(const JSONPath<N> &a, const JSONPath<M> &b)
+{
+    JSONPath<N + M> ret;
+
+    for(size_t i = 0; i < N; i++)
+        ret.frames[i] = a.frames[i];
+    for(size_t i = 0; i < M; i++)
+        ret.frames[N + i] = b.frames[i];
+
+    return ret;
+}
+
+// routes parser events for a set of paths, skipping anything that can't match without tokenizing it
+class JSONPathMatcher final
+{
+public:
+    using Event = JSONStreamParser::Event;
+    using ValueFunc = std::function<void(Event, std::string_view)>;
+
+    static constexpr int max_paths = 16;
+
+    JSONPathMatcher(JSONStreamParser &parser);
+
+    // paths must outlive the matcher, called for values and container start/end events
+    template<size_t N>
+    bool on(const JSONPath<N> &path, ValueFunc fun)
+    {
+        static_assert(N <= JSONStreamParser::max_depth, "path too deep");
+        return add_binding(path.frames, N, fun);
+    }
+
+    // store scalar values directly
+    template<size_t N>
+    bool bind(const JSONPath<N> &path, int &value)
+    {
+        return on(path, [&value](Event event, std::string_view str){set_value(event, str, value);});
+    }
+
+    template<size_t N>
+    bool bind(const JSONPath<N> &path, bool &value)
+    {
+        return on(path, [&value](Event event, std::string_view str){set_value(event, str, value);});
+    }
+
+    template<size_t N>
+    bool bind(const JSONPath<N> &path, std::string &value)
+    {
+        return on(path, [&value](Event event, std::string_view str){set_value(event, str, value);});
+    }
+
+    void clear();
+
+    // index of the nth json_each in the path currently being handled
+    int getEachIndex(int n) const;
+
+    // key matched by the nth json_any_key in the path currently being handled
+    std::string_view getAnyKey(int n) const;
+
+private:
+    struct Binding
+    {
+        const JSONPathFrame *frames;
+        int len;
+        ValueFunc fun;
+    };
+
+    bool add_binding(const JSONPathFrame *frames, int len, ValueFunc fun);
+
+    void on_event(Event event, std::string_view value);
+
+    uint32_t match_current(int depth) const;
+
+    static void set_value(Event event, std::string_view str, int &value);
+    static void set_value(Event event, std::string_view str, bool &value);
+    static void set_value(Event event, std::string_view str, std::string &value);
+
+    JSONStreamParser &parser;
+
+    Binding bindings[max_paths];
+    int num_bindings = 0;
+
+    // bindings matching each open container
+    uint32_t live[JSONStreamParser::max_depth + 1];
+
+    const Binding *current = nullptr;
+};
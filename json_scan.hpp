@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// word-at-a-time scanning for the characters the JSON parser cares about
+// each test handles four bytes with a few ALU ops, the M0+ has no SIMD but this is nearly as good for short runs
+
+namespace json_scan
+{
+    constexpr uint32_t ones = 0x01010101;
+    constexpr uint32_t highs = 0x80808080;
+
+    // high bit set in each byte that is zero, exact for the lowest one (higher bytes may have false positives)
+    constexpr uint32_t zero_bytes(uint32_t v)
+    {
+        return (v - ones) & ~v & highs;
+    }
+
+    constexpr uint32_t matching_bytes(uint32_t v, uint8_t c)
+    {
+        return zero_bytes(v ^ (ones * c));
+    }
+
+    // bytes < n, n <= 128
+    constexpr uint32_t bytes_less_than(uint32_t v, uint8_t n)
+    {
+        return (v - ones * n) & ~v & highs;
+    }
+
+    inline uint32_t load_word(const uint8_t *p)
+    {
+        uint32_t v;
+        memcpy(&v, __builtin_assume_aligned(p, 4), 4);
+        return v;
+    }
+
+    inline size_t first_byte(uint32_t mask)
+    {
+        return __builtin_ctz(mask) >> 3;
+    }
+
+    // applies test to aligned words, handling any unaligned start/end bytewise
+    // returns the offset of the first byte test_byte matches, or len
+    template<class WordTest, class ByteTest>
+    inline size_t find(const uint8_t *data, size_t len, WordTest test_word, ByteTest test_byte)
+    {
+        size_t i = 0;
+
+        for(; i < len && (uintptr_t(data + i) & 3); i++)
+        {
+            if(test_byte(data[i]))
+                return i;
+        }
+
+        for(; i + 4 <= len; i += 4)
+        {
+            if(test_word(load_word(data + i)))
+                break;
+        }
+
+        for(; i < len; i++)
+        {
+            if(test_byte(data[i]))
+                return i;
+        }
+
+        return len;
+    }
+
+    // end of a run of plain string characters: " \ or a control character
+    inline size_t find_string_special(const uint8_t *data, size_t len)
+    {
+        return find(data, len,
+            [](uint32_t v){return matching_bytes(v, '"') | matching_bytes(v, '\\') | bytes_less_than(v, 0x20);},
+            [](uint8_t c){return c == '"' || c == '\\' || c < 0x20;});
+    }
+
+    // next " \ { } [ or ]
+    // { and [ (and } and ]) only differ by 0x20, so they can share a test
+    inline size_t find_structural(const uint8_t *data, size_t len)
+    {
+        return find(data, len,
+            [](uint32_t v)
+            {
+                uint32_t folded = v | (ones * 0x20);
+                return matching_bytes(v, '"') | matching_bytes(v, '\\') | matching_bytes(folded, '{') | matching_bytes(folded, '}');
+            },
+            [](uint8_t c){return c == '"' || c == '\\' || (c | 0x20) == '{' || (c | 0x20) == '}';});
+    }
+
+    // skips a run of spaces (indentation), any other whitespace is left for the parser
+    inline size_t skip_spaces(const uint8_t *data, size_t len)
+    {
+        return find(data, len,
+            [](uint32_t v){return v != ones * ' ';},
+            [](uint8_t c){return c != ' ';});
+    }
+}
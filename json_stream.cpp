@@ -0,0 +1,579 @@
+#include <cstdio>
+#include <cstring>
+
+#include "json_scan.hpp"
+#include "json_stream.hpp"
+
+static bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static int hex_value(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+void JSONStreamParser::setOnEvent(EventFunc fun)
+{
+    onEvent = fun;
+}
+
+void JSONStreamParser::reset()
+{
+    state = State::Value;
+    depth = 0;
+    value_len = 0;
+    truncated = false;
+    escape_len = 0;
+    high_surrogate = 0;
+    skip_requested = false;
+
+    error = Error::None;
+    error_offset = 0;
+    stats = {};
+}
+
+bool JSONStreamParser::feed(const uint8_t *data, size_t len)
+{
+    if(state == State::Error)
+        return false;
+
+    size_t i = 0;
+
+    while(i < len)
+    {
+        if(state == State::Skip)
+        {
+            i += skip(data + i, len - i);
+            continue;
+        }
+
+        // plain runs inside strings and indentation don't need to go through the state machine
+        if(state == State::String && escape_len == 0)
+        {
+            size_t run = json_scan::find_string_special(data + i, len - i);
+
+            if(run)
+            {
+                append_string(data + i, run);
+                i += run;
+                continue;
+            }
+        }
+        else if(state <= State::AfterValue && data[i] == ' ')
+        {
+            i += json_scan::skip_spaces(data + i, len - i);
+            continue;
+        }
+
+        if(!parse_char(data[i]))
+        {
+            if(error == Error::None)
+                error = Error::Syntax;
+
+            error_offset = stats.bytes + i;
+            stats.bytes += len;
+
+            state = State::Error;
+            return false;
+        }
+
+        i++;
+    }
+
+    stats.bytes += len;
+
+    return true;
+}
+
+bool JSONStreamParser::isDone() const
+{
+    return state == State::Done;
+}
+
+bool JSONStreamParser::hasError() const
+{
+    return state == State::Error;
+}
+
+JSONStreamParser::Error JSONStreamParser::getError() const
+{
+    return error;
+}
+
+uint32_t JSONStreamParser::getErrorOffset() const
+{
+    return error_offset;
+}
+
+const JSONStreamParser::Stats &JSONStreamParser::getStats() const
+{
+    return stats;
+}
+
+void JSONStreamParser::printStats() const
+{
+    static const char *error_names[]{"none", "syntax error", "too deep"};
+
+    if(error != Error::None)
+        printf("JSON parse failed: %s at byte %u\n", error_names[int(error)], error_offset);
+
+    printf("JSON: %u bytes, depth %i/%i, longest string %i/%i, %i truncated strings, %i truncated keys\n",
+        stats.bytes, stats.max_depth, max_depth, stats.longest_string, max_string_len,
+        stats.truncated_strings, stats.truncated_keys);
+}
+
+int JSONStreamParser::getDepth() const
+{
+    return depth;
+}
+
+std::string_view JSONStreamParser::getKey(int depth) const
+{
+    auto &frame = stack[depth];
+    return std::string_view(frame.key, frame.key_len);
+}
+
+int JSONStreamParser::getIndex(int depth) const
+{
+    return stack[depth].index;
+}
+
+bool JSONStreamParser::isTruncated() const
+{
+    return truncated;
+}
+
+void JSONStreamParser::skipValue()
+{
+    skip_requested = true;
+}
+
+bool JSONStreamParser::parse_char(char c)
+{
+    switch(state)
+    {
+        case State::ArrayValueOrEnd:
+            if(c == ']')
+                return close_container(true);
+            [[fallthrough]];
+
+        case State::Value:
+            if(is_whitespace(c))
+                return true;
+
+            value_len = value_full_len = 0;
+            truncated = false;
+
+            switch(c)
+            {
+                case '{':
+                    return open_container(false);
+                case '[':
+                    return open_container(true);
+
+                case '"':
+                    in_key = false;
+                    state = State::String;
+                    return true;
+
+                case 't':
+                    literal = "rue";
+                    literal_event = Event::True;
+                    state = State::Literal;
+                    return true;
+                case 'f':
+                    literal = "alse";
+                    literal_event = Event::False;
+                    state = State::Literal;
+                    return true;
+                case 'n':
+                    literal = "ull";
+                    literal_event = Event::Null;
+                    state = State::Literal;
+                    return true;
+
+                default:
+                    if(c == '-' || (c >= '0' && c <= '9'))
+                    {
+                        append_string_char(c);
+                        state = State::Number;
+                        return true;
+                    }
+                    return false;
+            }
+
+        case State::ObjectKeyOrEnd:
+            if(c == '}')
+                return close_container(false);
+            [[fallthrough]];
+
+        case State::ObjectKey:
+            if(is_whitespace(c))
+                return true;
+
+            if(c != '"')
+                return false;
+
+            value_len = value_full_len = 0;
+            truncated = false;
+            in_key = true;
+            state = State::String;
+            return true;
+
+        case State::Colon:
+            if(is_whitespace(c))
+                return true;
+
+            if(c != ':')
+                return false;
+
+            state = State::Value;
+            return true;
+
+        case State::AfterValue:
+            if(is_whitespace(c))
+                return true;
+
+            if(c == ',')
+            {
+                auto &frame = stack[depth - 1];
+                if(frame.is_array)
+                {
+                    frame.index++;
+                    state = State::Value;
+                }
+                else
+                    state = State::ObjectKey;
+
+                return true;
+            }
+
+            if(c == ']')
+                return close_container(true);
+
+            if(c == '}')
+                return close_container(false);
+
+            return false;
+
+        case State::String:
+            return parse_string_char(c);
+
+        case State::Number:
+            if((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+            {
+                append_string_char(c);
+                return true;
+            }
+
+            emit(Event::Number, std::string_view(value, value_len));
+            end_value();
+
+            // the terminator belongs to the next token
+            return parse_char(c);
+
+        case State::Literal:
+            if(c != *literal)
+                return false;
+
+            if(!*++literal)
+            {
+                emit(literal_event);
+                end_value();
+            }
+            return true;
+
+        case State::Skip: // handled in feed
+            return false;
+
+        case State::Done:
+            return is_whitespace(c);
+
+        case State::Error:
+            return false;
+    }
+
+    return false;
+}
+
+size_t JSONStreamParser::skip(const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+
+    while(i < len)
+    {
+        if(skip_escape)
+        {
+            skip_escape = false;
+            i++;
+            continue;
+        }
+
+        // everything else is irrelevant here
+        i += json_scan::find_structural(data + i, len - i);
+
+        if(i == len)
+            break;
+
+        char c = data[i++];
+
+        if(skip_in_string)
+        {
+            if(c == '\\')
+                skip_escape = true;
+            else if(c == '"')
+                skip_in_string = false;
+
+            continue;
+        }
+
+        switch(c)
+        {
+            case '"':
+                skip_in_string = true;
+                break;
+
+            case '{':
+            case '[':
+                skip_nesting++;
+                break;
+
+            case '}':
+            case ']':
+                if(--skip_nesting == 0)
+                {
+                    end_value();
+                    return i;
+                }
+                break;
+        }
+    }
+
+    return len;
+}
+
+bool JSONStreamParser::parse_string_char(char c)
+{
+    if(escape_len == 0)
+    {
+        if(c == '"')
+        {
+            end_string();
+            return true;
+        }
+
+        if(c == '\\')
+        {
+            escape_len = 1;
+            return true;
+        }
+
+        // control characters need to be escaped
+        if(uint8_t(c) < 0x20)
+            return false;
+
+        append_string_char(c);
+        return true;
+    }
+
+    if(escape_len == 1)
+    {
+        escape_len = 0;
+
+        switch(c)
+        {
+            case '"':
+            case '\\':
+            case '/':
+                append_string_char(c);
+                return true;
+            case 'b':
+                append_string_char('\b');
+                return true;
+            case 'f':
+                append_string_char('\f');
+                return true;
+            case 'n':
+                append_string_char('\n');
+                return true;
+            case 'r':
+                append_string_char('\r');
+                return true;
+            case 't':
+                append_string_char('\t');
+                return true;
+
+            case 'u':
+                escape_len = 2;
+                escape_code = 0;
+                return true;
+        }
+
+        return false;
+    }
+
+    // \uXXXX
+    int digit = hex_value(c);
+    if(digit < 0)
+        return false;
+
+    escape_code = escape_code << 4 | digit;
+
+    if(++escape_len < 6)
+        return true;
+
+    escape_len = 0;
+
+    if(escape_code >= 0xD800 && escape_code < 0xDC00)
+        high_surrogate = escape_code;
+    else if(escape_code >= 0xDC00 && escape_code < 0xE000 && high_surrogate)
+    {
+        append_utf8(0x10000 + ((high_surrogate - 0xD800) << 10) + (escape_code - 0xDC00));
+        high_surrogate = 0;
+    }
+    else
+        append_utf8(escape_code);
+
+    return true;
+}
+
+void JSONStreamParser::end_string()
+{
+    if(value_full_len > stats.longest_string)
+        stats.longest_string = value_full_len;
+
+    if(in_key)
+    {
+        auto &frame = stack[depth - 1];
+        frame.key_len = value_len < max_key_len ? value_len : max_key_len;
+        memcpy(frame.key, value, frame.key_len);
+
+        if(value_full_len > max_key_len)
+            stats.truncated_keys++;
+
+        state = State::Colon;
+    }
+    else
+    {
+        if(truncated)
+            stats.truncated_strings++;
+
+        emit(Event::String, std::string_view(value, value_len));
+        end_value();
+    }
+}
+
+void JSONStreamParser::append_string_char(char c)
+{
+    value_full_len++;
+
+    if(value_len < max_string_len)
+        value[value_len++] = c;
+    else
+        truncated = true;
+}
+
+void JSONStreamParser::append_string(const uint8_t *data, size_t len)
+{
+    value_full_len += len;
+
+    size_t space = max_string_len - value_len;
+    if(len > space)
+    {
+        len = space;
+        truncated = true;
+    }
+
+    memcpy(value + value_len, data, len);
+    value_len += len;
+}
+
+void JSONStreamParser::append_utf8(uint32_t code_point)
+{
+    if(code_point < 0x80)
+        append_string_char(code_point);
+    else if(code_point < 0x800)
+    {
+        append_string_char(0xC0 | code_point >> 6);
+        append_string_char(0x80 | (code_point & 0x3F));
+    }
+    else if(code_point < 0x10000)
+    {
+        append_string_char(0xE0 | code_point >> 12);
+        append_string_char(0x80 | ((code_point >> 6) & 0x3F));
+        append_string_char(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        append_string_char(0xF0 | code_point >> 18);
+        append_string_char(0x80 | ((code_point >> 12) & 0x3F));
+        append_string_char(0x80 | ((code_point >> 6) & 0x3F));
+        append_string_char(0x80 | (code_point & 0x3F));
+    }
+}
+
+void JSONStreamParser::end_value()
+{
+    state = depth == 0 ? State::Done : State::AfterValue;
+}
+
+bool JSONStreamParser::open_container(bool is_array)
+{
+    if(depth == max_depth)
+    {
+        error = Error::TooDeep;
+        return false;
+    }
+
+    // event is at the container's own path
+    skip_requested = false;
+    emit(is_array ? Event::ArrayStart : Event::ObjectStart);
+
+    if(skip_requested)
+    {
+        skip_requested = false;
+        skip_nesting = 1;
+        skip_in_string = skip_escape = false;
+        state = State::Skip;
+        return true;
+    }
+
+    auto &frame = stack[depth++];
+    frame.is_array = is_array;
+
+    if(depth > stats.max_depth)
+        stats.max_depth = depth;
+
+    frame.index = is_array ? 0 : -1;
+    frame.key_len = 0;
+
+    state = is_array ? State::ArrayValueOrEnd : State::ObjectKeyOrEnd;
+    return true;
+}
+
+bool JSONStreamParser::close_container(bool is_array)
+{
+    if(depth == 0 || stack[depth - 1].is_array != is_array)
+        return false;
+
+    depth--;
+    emit(is_array ? Event::ArrayEnd : Event::ObjectEnd);
+
+    end_value();
+    return true;
+}
+
+void JSONStreamParser::emit(Event event, std::string_view value)
+{
+    if(onEvent)
+        onEvent(event, value);
+}
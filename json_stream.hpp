@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// incremental JSON tokenizer, can be fed a response body in arbitrary chunks
+// uses a fixed amount of memory, strings longer than max_string_len are truncated
+class JSONStreamParser final
+{
+public:
+    enum class Event
+    {
+        ObjectStart,
+        ObjectEnd,
+        ArrayStart,
+        ArrayEnd,
+        String,
+        Number,
+        True,
+        False,
+        Null
+    };
+
+    enum class Error
+    {
+        None,
+        Syntax,
+        TooDeep, // more than max_depth nested containers
+    };
+
+    // per-parse usage, to see how close a response gets to the fixed limits
+    struct Stats
+    {
+        uint32_t bytes;
+        int max_depth;
+        int longest_string; // including any truncated part
+        int truncated_strings;
+        int truncated_keys;
+    };
+
+    // value is only valid during the call, the path to the value can be queried with getDepth/getKey/getIndex
+    using EventFunc = std::function<void(Event, std::string_view)>;
+
+    static constexpr int max_depth = 16;
+    static constexpr int max_key_len = 32;
+    static constexpr int max_string_len = 128;
+
+    void setOnEvent(EventFunc fun);
+
+    void reset();
+
+    // returns false once an error has been found
+    bool feed(const uint8_t *data, size_t len);
+
+    bool isDone() const;
+    bool hasError() const;
+
+    Error getError() const;
+    uint32_t getErrorOffset() const; // byte offset into the document
+
+    const Stats &getStats() const;
+    void printStats() const;
+
+    // number of containers around the current value
+    int getDepth() const;
+
+    // key of the value at this depth (empty for array elements)
+    std::string_view getKey(int depth) const;
+
+    // index of the value at this depth (-1 for object members)
+    int getIndex(int depth) const;
+
+    // the last string event was cut short
+    bool isTruncated() const;
+
+    // call from an ObjectStart/ArrayStart event to skip over the contents without tokenizing them
+    // no further events (including the end) will be emitted for it and it isn't validated
+    void skipValue();
+
+private:
+    // everything up to AfterValue is between tokens, where whitespace can be skipped
+    enum class State
+    {
+        Value,
+        ArrayValueOrEnd,
+        ObjectKeyOrEnd,
+        ObjectKey,
+        Colon,
+        AfterValue,
+        String,
+        Number,
+        Literal,
+        Skip,
+        Done,
+        Error
+    };
+
+    struct Frame
+    {
+        bool is_array;
+        int index;
+        uint8_t key_len;
+        char key[max_key_len];
+    };
+
+    bool parse_char(char c);
+    void end_string();
+    size_t skip(const uint8_t *data, size_t len);
+    bool parse_string_char(char c);
+    void append_string_char(char c);
+    void append_string(const uint8_t *data, size_t len);
+    void append_utf8(uint32_t code_point);
+
+    void end_value();
+    bool open_container(bool is_array);
+    bool close_container(bool is_array);
+
+    void emit(Event event, std::string_view value = {});
+
+    EventFunc onEvent;
+
+    State state = State::Value;
+
+    Frame stack[max_depth];
+    int depth = 0;
+
+    // string/number/literal being parsed
+    char value[max_string_len];
+    int value_len = 0, value_full_len = 0;
+    bool truncated = false;
+    bool in_key = false;
+
+    // escape sequences
+    int escape_len = 0; // 1 for \, 2-5 for \uXXXX
+    uint32_t escape_code = 0;
+    uint32_t high_surrogate = 0;
+
+    // skipping a container
+    bool skip_requested = false;
+    int skip_nesting = 0;
+    bool skip_in_string = false;
+    bool skip_escape = false;
+
+    // true/false/null
+    const char *literal = nullptr;
+    Event literal_event;
+
+    Error error = Error::None;
+    uint32_t error_offset = 0;
+
+    Stats stats = {};
+};
@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "kv_store.hpp"
+
+KVStore::KVStore(FlashRegion &flash) : flash(flash)
+{
+}
+
+bool KVStore::init()
+{
+    if(!flash.init())
+        return false;
+
+    // one being written, one spare and at least one for data
+    int num_sectors = flash.getNumSectors();
+    if(num_sectors < 3)
+        return false;
+
+    sectors.assign(num_sectors, {});
+
+    index.clear();
+    head = -1;
+    next_sequence = 0;
+
+    for(int i = 0; i < num_sectors; i++)
+    {
+        SectorHeader header;
+        if(!flash.read(i * FlashRegion::sector_size, &header, sizeof(header)))
+            return false;
+
+        // keep the wear count of reclaimed sectors
+        if(header.magic == retired_magic)
+            sectors[i].erase_count = header.erase_count;
+
+        if(header.magic != sector_magic || header.crc != crc32(&header, offsetof(SectorHeader, crc)))
+            continue;
+
+        sectors[i] = {true, header.sequence, header.erase_count};
+        next_sequence = std::max(next_sequence, header.sequence + 1);
+    }
+
+    // oldest first, so newer copies replace older ones in the index
+    std::vector<int> order;
+    for(int i = 0; i < num_sectors; i++)
+    {
+        if(sectors[i].in_use)
+            order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), [this](int a, int b){return sectors[a].sequence < sectors[b].sequence;});
+
+    for(auto sector : order)
+    {
+        bool clean = scan_sector(sector);
+
+        // can't write after a bad record, start a new sector next time
+        head = sector;
+        if(!clean)
+            head_offset = FlashRegion::sector_size;
+    }
+
+    live_bytes = 0;
+    for(auto &entry : index)
+        live_bytes += record_size(entry.first.length(), entry.second.value_len);
+
+    printf("kv store: %i keys, %u bytes live\n", index.size(), live_bytes);
+
+    return true;
+}
+
+int KVStore::getLength(std::string_view key) const
+{
+    auto it = index.find(key);
+    return it == index.end() ? -1 : it->second.value_len;
+}
+
+int KVStore::get(std::string_view key, void *data, size_t max_len) const
+{
+    auto it = index.find(key);
+    if(it == index.end() || it->second.value_len > max_len)
+        return -1;
+
+    auto &loc = it->second;
+
+    if(!flash.read(loc.addr + sizeof(RecordHeader) + key.length(), data, loc.value_len))
+        return -1;
+
+    return loc.value_len;
+}
+
+bool KVStore::put(std::string_view key, const void *data, size_t len)
+{
+    if(key.empty() || key.length() > max_key_len || len > getMaxValueLength(key.length()))
+        return false;
+
+    return write_record(key, flag_live, data, len);
+}
+
+bool KVStore::remove(std::string_view key)
+{
+    if(index.find(key) == index.end())
+        return true;
+
+    return write_record(key, flag_deleted, nullptr, 0);
+}
+
+size_t KVStore::getMaxValueLength(size_t key_len) const
+{
+    size_t space = FlashRegion::sector_size - sizeof(SectorHeader) - sizeof(RecordHeader) - key_len;
+    return std::min(space & ~3, size_t(0xFFFF));
+}
+
+const KVStore::Stats &KVStore::getStats() const
+{
+    return stats;
+}
+
+void KVStore::printStats() const
+{
+    uint32_t min_erases = ~0u, max_erases = 0;
+    int used = 0;
+
+    for(auto &sector : sectors)
+    {
+        min_erases = std::min(min_erases, sector.erase_count);
+        max_erases = std::max(max_erases, sector.erase_count);
+
+        if(sector.in_use)
+            used++;
+    }
+
+    printf("kv store: %i keys, %u bytes live, %i/%i sectors used, erase counts %u-%u\n",
+        index.size(), live_bytes, used, sectors.size(), min_erases, max_erases);
+    printf("kv store: %u writes, %u skipped, %u erases, %u relocated, %u bad records\n",
+        stats.writes, stats.skipped_writes, stats.erases, stats.relocated, stats.bad_records);
+}
+
+size_t KVStore::record_size(size_t key_len, size_t value_len)
+{
+    return (sizeof(RecordHeader) + key_len + value_len + 3) & ~3;
+}
+
+uint32_t KVStore::crc32(const void *data, size_t len, uint32_t crc)
+{
+    auto bytes = static_cast<const uint8_t *>(data);
+
+    crc = ~crc;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        crc ^= bytes[i];
+
+        for(int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+// returns false if it stopped at a bad record
+bool KVStore::scan_sector(int sector)
+{
+    uint32_t base = sector * FlashRegion::sector_size;
+    uint32_t off = sizeof(SectorHeader);
+
+    std::vector<uint8_t> buf;
+
+    while(off + sizeof(RecordHeader) <= FlashRegion::sector_size)
+    {
+        RecordHeader header;
+        if(!flash.read(base + off, &header, sizeof(header)))
+            return false;
+
+        // erased, end of the log
+        if(header.crc == ~0u && header.value_len == 0xFFFF && header.key_len == 0xFF && header.flags == 0xFF)
+        {
+            head_offset = off;
+            return true;
+        }
+
+        size_t size = record_size(header.key_len, header.value_len);
+        bool valid = (header.flags == flag_live || header.flags == flag_deleted) && header.key_len && off + size <= FlashRegion::sector_size;
+
+        if(valid)
+        {
+            buf.resize(header.key_len + header.value_len);
+            valid = flash.read(base + off + sizeof(header), buf.data(), buf.size());
+        }
+
+        if(valid)
+        {
+            uint32_t crc = crc32(&header.value_len, sizeof(header) - offsetof(RecordHeader, value_len));
+            valid = crc32(buf.data(), buf.size(), crc) == header.crc;
+        }
+
+        if(!valid)
+        {
+            printf("kv store: bad record in sector %i at %u\n", sector, off);
+            stats.bad_records++;
+            return false;
+        }
+
+        std::string key(reinterpret_cast<char *>(buf.data()), header.key_len);
+
+        if(header.flags == flag_deleted)
+            index.erase(key);
+        else
+            index[key] = {base + off, header.value_len, header.crc};
+
+        off += size;
+    }
+
+    head_offset = FlashRegion::sector_size;
+    return true;
+}
+
+bool KVStore::write_record(std::string_view key, uint8_t flags, const void *data, size_t len)
+{
+    // not initialised
+    if(sectors.empty())
+        return false;
+
+    size_t size = record_size(key.length(), len);
+
+    RecordHeader header{0, uint16_t(len), uint8_t(key.length()), flags};
+    uint32_t crc = crc32(&header.value_len, sizeof(header) - offsetof(RecordHeader, value_len));
+    crc = crc32(key.data(), key.length(), crc);
+    header.crc = crc32(data, len, crc);
+
+    auto it = index.find(key);
+
+    if(it != index.end() && flags == flag_live && it->second.crc == header.crc && it->second.value_len == len)
+    {
+        stats.skipped_writes++;
+        return true;
+    }
+
+    // keep two sectors spare, so compacting the oldest always has somewhere to go
+    size_t old_size = it == index.end() ? 0 : record_size(key.length(), it->second.value_len);
+    size_t capacity = (sectors.size() - 2) * (FlashRegion::sector_size - sizeof(SectorHeader));
+
+    if(flags == flag_live && live_bytes - old_size + size > capacity)
+    {
+        printf("kv store: full, can't write %.*s\n", key.length(), key.data());
+        return false;
+    }
+
+    std::vector<uint8_t> record(size, 0xFF);
+    memcpy(record.data(), &header, sizeof(header));
+    memcpy(record.data() + sizeof(header), key.data(), key.length());
+    if(len)
+        memcpy(record.data() + sizeof(header) + key.length(), data, len);
+
+    uint32_t addr;
+    if(!append(record.data(), size, addr))
+        return false;
+
+    stats.writes++;
+
+    // the old one may have moved during compaction
+    it = index.find(key);
+    if(it != index.end())
+    {
+        live_bytes -= record_size(key.length(), it->second.value_len);
+        index.erase(it);
+    }
+
+    if(flags == flag_live)
+    {
+        index.emplace(key, Location{addr, uint16_t(len), header.crc});
+        live_bytes += size;
+    }
+
+    return true;
+}
+
+bool KVStore::append(const void *record, size_t len, uint32_t &addr)
+{
+    // each new sector may reclaim the oldest, which may not free enough on its own
+    for(size_t attempt = 0; head < 0 || head_offset + len > FlashRegion::sector_size; attempt++)
+    {
+        if(attempt == sectors.size() || !open_sector())
+            return false;
+    }
+
+    addr = head * FlashRegion::sector_size + head_offset;
+
+    if(!flash.program(addr, record, len))
+        return false;
+
+    head_offset += len;
+    return true;
+}
+
+bool KVStore::open_sector()
+{
+    int num_sectors = sectors.size();
+
+    // the next unused one in order, so every sector gets erased as often as the others
+    int sector = -1;
+    for(int i = 1; i <= num_sectors; i++)
+    {
+        int s = (head + i + num_sectors) % num_sectors;
+        if(!sectors[s].in_use)
+        {
+            sector = s;
+            break;
+        }
+    }
+
+    if(sector < 0)
+        return false;
+
+    SectorHeader header{sector_magic, next_sequence++, sectors[sector].erase_count + 1, 0};
+    header.crc = crc32(&header, offsetof(SectorHeader, crc));
+
+    stats.erases++;
+
+    if(!flash.erase(sector) || !flash.program(sector * FlashRegion::sector_size, &header, sizeof(header)))
+        return false;
+
+    sectors[sector] = {true, header.sequence, header.erase_count};
+    head = sector;
+    head_offset = sizeof(SectorHeader);
+
+    // that was the last spare, compact the oldest into the new one
+    if(std::none_of(sectors.begin(), sectors.end(), [](const Sector &s){return !s.in_use;}))
+    {
+        int oldest = -1;
+        for(int i = 0; i < num_sectors; i++)
+        {
+            if(i != head && (oldest < 0 || sectors[i].sequence < sectors[oldest].sequence))
+                oldest = i;
+        }
+
+        return reclaim_sector(oldest);
+    }
+
+    return true;
+}
+
+bool KVStore::reclaim_sector(int sector)
+{
+    uint32_t start = sector * FlashRegion::sector_size;
+    uint32_t end = start + FlashRegion::sector_size;
+
+    std::vector<uint8_t> record;
+
+    for(auto &entry : index)
+    {
+        auto &loc = entry.second;
+        if(loc.addr < start || loc.addr >= end)
+            continue;
+
+        // the record is copied as-is, the CRC doesn't depend on where it is
+        record.resize(record_size(entry.first.length(), loc.value_len));
+
+        uint32_t new_addr = head * FlashRegion::sector_size + head_offset;
+
+        if(head_offset + record.size() > FlashRegion::sector_size || !flash.read(loc.addr, record.data(), record.size()) || !flash.program(new_addr, record.data(), record.size()))
+            return false;
+
+        head_offset += record.size();
+        loc.addr = new_addr;
+        stats.relocated++;
+    }
+
+    // clearing the magic is enough to stop anything in it coming back after a reboot, it's erased when reused
+    uint32_t magic = retired_magic;
+    if(!flash.program(start + offsetof(SectorHeader, magic), &magic, sizeof(magic)))
+        return false;
+
+    sectors[sector].in_use = false;
+
+    return true;
+}
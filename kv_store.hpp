@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "flash_region.hpp"
+
+// small log-structured key-value store
+// records are only ever appended, so a value is replaced by writing a newer copy after it
+// sectors are used in turn, the oldest one's live records are copied forward before it's erased (which also spreads the wear)
+// every record has a CRC, anything after a bad one (a write cut short by a power cycle) is ignored
+class KVStore final
+{
+public:
+    struct Stats
+    {
+        uint32_t writes;
+        uint32_t skipped_writes; // same as the existing value
+        uint32_t erases;
+        uint32_t relocated; // records copied forward by compaction
+        uint32_t bad_records;
+    };
+
+    static constexpr size_t max_key_len = 255;
+
+    KVStore(FlashRegion &flash);
+
+    // scans the region and builds the index, needed before anything else
+    bool init();
+
+    // length of the value, -1 if not found
+    int getLength(std::string_view key) const;
+
+    // returns the length read, -1 if not found or it doesn't fit
+    int get(std::string_view key, void *data, size_t max_len) const;
+
+    bool put(std::string_view key, const void *data, size_t len);
+    bool remove(std::string_view key);
+
+    // largest value that will fit, with this key length
+    size_t getMaxValueLength(size_t key_len) const;
+
+    const Stats &getStats() const;
+    void printStats() const;
+
+private:
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t erase_count;
+        uint32_t crc;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t crc; // of the rest of the header, key and value
+        uint16_t value_len;
+        uint8_t key_len;
+        uint8_t flags;
+    };
+
+    struct Sector
+    {
+        bool in_use;
+        uint32_t sequence;
+        uint32_t erase_count;
+    };
+
+    struct Location
+    {
+        uint32_t addr; // of the record header
+        uint16_t value_len;
+        uint32_t crc;
+    };
+
+    static constexpr uint32_t sector_magic = 0x3153564B; // KVS1
+    static constexpr uint32_t retired_magic = 0;
+    static constexpr uint8_t flag_live = 0x5A;
+    static constexpr uint8_t flag_deleted = 0xA5;
+
+    static size_t record_size(size_t key_len, size_t value_len);
+
+    static uint32_t crc32(const void *data, size_t len, uint32_t crc = 0);
+
+    bool scan_sector(int sector);
+
+    bool write_record(std::string_view key, uint8_t flags, const void *data, size_t len);
+    bool append(const void *record, size_t len, uint32_t &addr);
+
+    bool open_sector();
+    bool reclaim_sector(int sector);
+
+    FlashRegion &flash;
+
+    std::vector<Sector> sectors;
+    int head = -1; // being written to
+    uint32_t head_offset = 0;
+    uint32_t next_sequence = 0;
+
+    std::map<std::string, Location, std::less<>> index;
+    size_t live_bytes = 0;
+
+    Stats stats = {};
+};
@@ -0,0 +1,51 @@
+#include <algorithm>
+
+#include "quantize.hpp"
+
+QuantizeThresholds quantize_thresholds(const uint16_t *counts, size_t num_counts, int num_levels, uint16_t *scratch)
+{
+    QuantizeThresholds ret;
+
+    ret.num_levels = std::clamp(num_levels, 2, quantize_max_levels);
+    ret.min_count[0] = 0;
+
+    // only non-zero days are ranked
+    size_t n = 0;
+    for(size_t i = 0; i < num_counts; i++)
+    {
+        if(counts[i])
+            scratch[n++] = counts[i];
+    }
+
+    int steps = ret.num_levels - 1;
+    auto begin = scratch, end = scratch + n;
+
+    // each selection partitions the rest, so the next one only has to look above the previous
+    for(int level = 1; level <= steps; level++)
+    {
+        uint16_t value = 0;
+
+        if(n)
+        {
+            auto nth = scratch + (level - 1) * n / steps;
+            std::nth_element(begin, nth, end);
+            begin = nth;
+            value = *nth;
+        }
+
+        // never below the previous level, and never 0 so that no contributions stays distinct
+        ret.min_count[level] = std::max<uint16_t>(value, std::max<uint16_t>(ret.min_count[level - 1], 1));
+    }
+
+    return ret;
+}
+
+int quantize_level(const QuantizeThresholds &thresholds, uint16_t count)
+{
+    int level = 0;
+
+    while(level + 1 < thresholds.num_levels && count >= thresholds.min_count[level + 1])
+        level++;
+
+    return level;
+}
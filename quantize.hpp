@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// maps raw contribution counts to a number of levels, adapting to the distribution like GitHub's quartiles do
+// zero is always level 0, the remaining days are split evenly between levels 1 to num_levels - 1
+
+static constexpr int quantize_max_levels = 16;
+
+struct QuantizeThresholds
+{
+    int num_levels;
+    uint16_t min_count[quantize_max_levels]; // lowest count for each level
+};
+
+// scratch needs space for num_counts values, counts is not modified
+QuantizeThresholds quantize_thresholds(const uint16_t *counts, size_t num_counts, int num_levels, uint16_t *scratch);
+
+int quantize_level(const QuantizeThresholds &thresholds, uint16_t count);
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+#include "date.hpp"
+#include "http_client.hpp"
+#include "rate_limiter.hpp"
+
+// until there's a Retry-After, for secondary limits
+static constexpr uint32_t default_block_ms = 60 * 1000;
+
+static bool parse_int(std::string_view str, int &value)
+{
+    return std::from_chars(str.data(), str.data() + str.length(), value).ec == std::errc();
+}
+
+RateLimiter::RateLimiter(int reserve, int burst) : reserve(reserve), burst(burst), tokens(int64_t(burst) * 1000)
+{
+}
+
+void RateLimiter::onStatus(int code)
+{
+    if(code != 403 && code != 429)
+        return;
+
+    stats.limited_responses++;
+
+    blocked = true;
+    blocked_until = to_ms_since_boot(get_absolute_time()) + default_block_ms;
+}
+
+void RateLimiter::onHeader(std::string_view name, std::string_view value)
+{
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    int int_value;
+
+    if(HTTPClient::headerNameEquals(name, "Date"))
+    {
+        if(parse_http_time(value, server_time))
+        {
+            server_time_local = now;
+            have_server_time = true;
+        }
+    }
+    else if(HTTPClient::headerNameEquals(name, "X-RateLimit-Limit"))
+    {
+        if(parse_int(value, int_value))
+            limit = int_value;
+    }
+    else if(HTTPClient::headerNameEquals(name, "X-RateLimit-Remaining"))
+    {
+        if(parse_int(value, int_value))
+            remaining = int_value;
+    }
+    else if(HTTPClient::headerNameEquals(name, "X-RateLimit-Reset"))
+    {
+        if(parse_int(value, int_value) && have_server_time)
+        {
+            reset_time = to_local_time(int_value);
+            have_reset_time = true;
+        }
+    }
+    else if(HTTPClient::headerNameEquals(name, "Retry-After"))
+    {
+        if(parse_int(value, int_value))
+        {
+            blocked = true;
+            blocked_until = now + int_value * 1000;
+        }
+    }
+}
+
+void RateLimiter::onGraphQLRateLimit(int cost, int remaining, std::string_view reset_at)
+{
+    this->cost = std::max(cost, 1);
+    this->remaining = remaining;
+
+    uint32_t time;
+    if(have_server_time && parse_iso_time(reset_at, time))
+    {
+        reset_time = to_local_time(time);
+        have_reset_time = true;
+    }
+}
+
+bool RateLimiter::canSend(Priority priority)
+{
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+
+    refill(now);
+
+    return allowed(priority, now);
+}
+
+bool RateLimiter::allowed(Priority priority, uint32_t now)
+{
+    if(blocked)
+    {
+        if(int32_t(now - blocked_until) < 0)
+            return false;
+
+        blocked = false;
+    }
+
+    if(remaining >= 0)
+    {
+        // would be refused
+        if(remaining < cost)
+            return false;
+
+        if(priority == Priority::Background && remaining - cost < reserve)
+            return false;
+    }
+
+    if(priority == Priority::Background && tokens < cost * 1000)
+        return false;
+
+    return true;
+}
+
+void RateLimiter::onSend(Priority priority)
+{
+    stats.sent[int(priority)]++;
+
+    // until the response says otherwise
+    if(remaining >= 0)
+        remaining = std::max(remaining - cost, 0);
+
+    if(priority == Priority::Background)
+        tokens -= cost * 1000;
+}
+
+int RateLimiter::getRemaining() const
+{
+    return remaining;
+}
+
+uint32_t RateLimiter::getWaitTime(Priority priority)
+{
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+
+    refill(now);
+
+    if(allowed(priority, now))
+        return 0;
+
+    if(blocked)
+        return blocked_until - now;
+
+    // out of points (or down to the reserve) until the reset
+    bool out = remaining >= 0 && (remaining < cost || (priority == Priority::Background && remaining - cost < reserve));
+
+    if(out)
+        return have_reset_time && int32_t(reset_time - now) > 0 ? reset_time - now : default_block_ms;
+
+    // waiting for the bucket, which refills at least once a second
+    return 1000;
+}
+
+uint32_t RateLimiter::getServerTime() const
+{
+    if(!have_server_time)
+        return 0;
+
+    return server_time + (to_ms_since_boot(get_absolute_time()) - server_time_local) / 1000;
+}
+
+uint32_t RateLimiter::getBackgroundInterval() const
+{
+    if(remaining < 0 || !have_reset_time)
+        return 0;
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    int32_t until_reset = std::max(int32_t(reset_time - now), 0);
+
+    int requests = (remaining - reserve) / cost;
+
+    return requests > 0 ? until_reset / requests : until_reset;
+}
+
+const RateLimiter::Stats &RateLimiter::getStats() const
+{
+    return stats;
+}
+
+void RateLimiter::printStats() const
+{
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    int reset_in = have_reset_time ? int32_t(reset_time - now) / 1000 : -1;
+
+    printf("rate limit: %i/%i remaining, cost %i, reset in %i s, background tokens %i.%03i\n",
+        remaining, limit, cost, reset_in, int(tokens / 1000), int(tokens % 1000));
+    printf("rate limit: %u interactive, %u background sent, %u limited\n",
+        stats.sent[int(Priority::Interactive)], stats.sent[int(Priority::Background)], stats.limited_responses);
+}
+
+uint32_t RateLimiter::to_local_time(uint32_t time) const
+{
+    return server_time_local + (time - server_time) * 1000;
+}
+
+void RateLimiter::refill(uint32_t now)
+{
+    uint32_t elapsed = now - last_refill;
+
+    // reset, the full limit is available again
+    if(have_reset_time && int32_t(now - reset_time) >= 0)
+    {
+        have_reset_time = false;
+
+        if(limit >= 0)
+            remaining = limit;
+    }
+
+    // spread what's left over the time until the reset, or refill immediately if that's unknown
+    int64_t rate_num, rate_den;
+
+    int64_t max_tokens = int64_t(burst) * 1000;
+
+    if(remaining < 0 || !have_reset_time)
+    {
+        tokens = max_tokens;
+        last_refill = now;
+        return;
+    }
+
+    rate_num = int64_t(std::max(remaining - reserve, 0)) * 1000;
+    rate_den = std::max(int32_t(reset_time - now), 1);
+
+    int64_t added = elapsed * rate_num / rate_den;
+
+    if(!rate_num || tokens + added >= max_tokens)
+    {
+        tokens = std::min(tokens + added, max_tokens);
+        last_refill = now;
+        return;
+    }
+
+    // only the time that was turned into tokens, at slow rates a call every few ms would otherwise always add 0
+    tokens += added;
+    last_refill += uint32_t(added * rate_den / rate_num);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// keeps track of the API's rate limit budget (shared with anything else using the same token)
+// interactive requests are only held back if they'd definitely be refused
+// background requests leave a reserve for interactive ones and are paced by a token bucket,
+// which refills at whatever rate would spend the rest of the budget by the time it resets
+class RateLimiter final
+{
+public:
+    enum class Priority
+    {
+        Background,
+        Interactive
+    };
+
+    struct Stats
+    {
+        uint32_t sent[2]; // by priority
+        uint32_t limited_responses; // 403/429
+    };
+
+    // reserve: points only interactive requests can use, burst: most background points that can build up
+    RateLimiter(int reserve, int burst);
+
+    // from every response
+    void onStatus(int code);
+    void onHeader(std::string_view name, std::string_view value);
+
+    // from the rateLimit { cost remaining resetAt } field of a GraphQL response
+    void onGraphQLRateLimit(int cost, int remaining, std::string_view reset_at);
+
+    // call before sending
+    bool canSend(Priority priority);
+
+    // counts the expected cost (the last one reported) against the budget
+    void onSend(Priority priority);
+
+    // -1 if unknown
+    int getRemaining() const;
+
+    // ms until a request of this priority could be sent, 0 if now
+    uint32_t getWaitTime(Priority priority);
+
+    // ms between background requests that would spend the budget above the reserve by the reset, 0 if unknown
+    uint32_t getBackgroundInterval() const;
+
+    // seconds since 1970, from the last Date header plus the time since, 0 until there's been one
+    uint32_t getServerTime() const;
+
+    const Stats &getStats() const;
+    void printStats() const;
+
+private:
+    // server time (seconds since 1970) to ms since boot
+    uint32_t to_local_time(uint32_t server_time) const;
+
+    void refill(uint32_t now);
+    bool allowed(Priority priority, uint32_t now);
+
+    int reserve, burst;
+
+    int limit = -1, remaining = -1;
+    int cost = 1;
+
+    uint32_t reset_time = 0; // ms since boot
+    bool have_reset_time = false;
+
+    uint32_t blocked_until = 0; // from Retry-After, or a 403/429
+    bool blocked = false;
+
+    // from the Date header
+    uint32_t server_time = 0, server_time_local = 0;
+    bool have_server_time = false;
+
+    // background bucket, in thousandths of a point
+    int64_t tokens;
+    uint32_t last_refill = 0;
+
+    Stats stats = {};
+};
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "refresh_policy.hpp"
+
+// scales to 0-255 relative to the largest
+template<size_t N>
+static bool normalise(const uint32_t (&totals)[N], uint8_t (&out)[N])
+{
+    uint32_t max = *std::max_element(totals, totals + N);
+
+    if(!max)
+        return false;
+
+    for(size_t i = 0; i < N; i++)
+        out[i] = uint64_t(totals[i]) * 255 / max;
+
+    return true;
+}
+
+RefreshPolicy::RefreshPolicy(const Config &config) : config(config)
+{
+}
+
+void RefreshPolicy::setEventTimes(const uint32_t *times, int num_times)
+{
+    uint32_t totals[24] = {};
+
+    // spread a little into the neighbouring hours, a few events won't hit every active hour
+    for(int i = 0; i < num_times; i++)
+    {
+        int hour = (times[i] / 3600) % 24;
+
+        totals[hour] += 2;
+        totals[(hour + 1) % 24]++;
+        totals[(hour + 23) % 24]++;
+    }
+
+    have_hours = normalise(totals, hour_activity);
+}
+
+void RefreshPolicy::setCalendar(const ContributionCalendar &calendar)
+{
+    uint32_t totals[7] = {};
+    bool is_count = calendar.getKind() == ContributionCalendar::Kind::Count;
+
+    for(int week = 0; week < calendar.getNumWeeks(); week++)
+    {
+        for(int day = 0; day < 7; day++)
+            totals[day] += is_count ? calendar.getCount(week, day) : unsigned(calendar.getLevel(week, day));
+    }
+
+    have_days = normalise(totals, day_activity);
+}
+
+void RefreshPolicy::onRefresh(bool changed)
+{
+    stats.refreshes++;
+
+    if(changed)
+        backoff = 0;
+    else
+    {
+        stats.unchanged++;
+        backoff = std::min(backoff + 1, max_backoff);
+    }
+}
+
+uint32_t RefreshPolicy::getInterval(uint32_t now, uint32_t min_interval_ms) const
+{
+    int activity = getActivity(now);
+
+    uint64_t interval = config.idle_interval_ms - uint64_t(config.idle_interval_ms - config.min_interval_ms) * activity / 255;
+
+    interval <<= backoff;
+
+    interval = std::clamp(interval, uint64_t(config.min_interval_ms), uint64_t(config.max_interval_ms));
+
+    return std::max(uint32_t(interval), min_interval_ms);
+}
+
+int RefreshPolicy::getActivity(uint32_t now) const
+{
+    // halfway without any history
+    int hour = have_hours && now ? hour_activity[(now / 3600) % 24] : 128;
+
+    // 1970-01-01 was a Thursday
+    int day = have_days && now ? day_activity[(now / 86400 + 4) % 7] : 255;
+
+    return hour * day / 255;
+}
+
+const RefreshPolicy::Stats &RefreshPolicy::getStats() const
+{
+    return stats;
+}
+
+void RefreshPolicy::printStats() const
+{
+    printf("refresh: %u refreshes, %u unchanged, backoff %i\n", stats.refreshes, stats.unchanged, backoff);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#include "contribution_calendar.hpp"
+
+// how long to wait before the next refresh
+// polls most often in the hours (from event timestamps) and on the days of the week (from the calendar) the user is usually active,
+// and doubles the interval after each refresh that found nothing new
+class RefreshPolicy final
+{
+public:
+    struct Config
+    {
+        uint32_t min_interval_ms; // the most active time, straight after a change
+        uint32_t idle_interval_ms; // the least active time, straight after a change
+        uint32_t max_interval_ms; // limit for backing off
+    };
+
+    struct Stats
+    {
+        uint32_t refreshes;
+        uint32_t unchanged;
+    };
+
+    RefreshPolicy(const Config &config);
+
+    // seconds since 1970 of recent activity, for the hour of day
+    void setEventTimes(const uint32_t *times, int num_times);
+
+    // per row (day of week) totals
+    void setCalendar(const ContributionCalendar &calendar);
+
+    void onRefresh(bool changed);
+
+    // now is seconds since 1970 (0 if unknown), at least min_interval_ms (usually from the rate limit)
+    uint32_t getInterval(uint32_t now, uint32_t min_interval_ms = 0) const;
+
+    // 0-255, how active the user usually is at this time
+    int getActivity(uint32_t now) const;
+
+    const Stats &getStats() const;
+    void printStats() const;
+
+private:
+    static constexpr int max_backoff = 8;
+
+    Config config;
+
+    // 0-255, relative to the busiest
+    uint8_t hour_activity[24];
+    uint8_t day_activity[7];
+    bool have_hours = false, have_days = false;
+
+    int backoff = 0; // unchanged refreshes in a row
+
+    Stats stats = {};
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// identical requests share one in-flight request instead of each sending their own
+// keyed by method, host, path and the body (hashed), everyone waiting gets the same result
+template<class... Args>
+class SingleFlight final
+{
+public:
+    using DoneFunc = std::function<void(Args...)>;
+
+    struct Key
+    {
+        std::string_view method, host, path;
+        uint32_t body_hash;
+        size_t body_len;
+    };
+
+    struct Stats
+    {
+        uint32_t started;
+        uint32_t joined;
+    };
+
+    static Key makeKey(std::string_view method, std::string_view host, std::string_view path, std::string_view body = {})
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261;
+        for(auto c : body)
+            hash = (hash ^ uint8_t(c)) * 16777619;
+
+        return {method, host, path, hash, body.length()};
+    }
+
+    // returns true if an identical request is in flight, fun is called with its result
+    bool join(const Key &key, DoneFunc fun)
+    {
+        int i = find(key);
+        if(i < 0)
+            return false;
+
+        if(fun)
+            flights[i].waiters.push_back(std::move(fun));
+
+        stats.joined++;
+        return true;
+    }
+
+    // after sending a request
+    void begin(const Key &key, DoneFunc fun)
+    {
+        flights.push_back({std::string(key.method), std::string(key.host), std::string(key.path), key.body_hash, key.body_len, {}});
+
+        if(fun)
+            flights.back().waiters.push_back(std::move(fun));
+
+        stats.started++;
+    }
+
+    // calls everything waiting for the request
+    void complete(const Key &key, Args... args)
+    {
+        int i = find(key);
+        if(i < 0)
+            return;
+
+        // a callback may start another request
+        auto waiters = std::move(flights[i].waiters);
+        flights.erase(flights.begin() + i);
+
+        for(auto &fun : waiters)
+            fun(args...);
+    }
+
+    bool isInFlight(const Key &key) const
+    {
+        return find(key) >= 0;
+    }
+
+    const Stats &getStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Flight
+    {
+        std::string method, host, path;
+        uint32_t body_hash;
+        size_t body_len;
+
+        std::vector<DoneFunc> waiters;
+    };
+
+    int find(const Key &key) const
+    {
+        for(size_t i = 0; i < flights.size(); i++)
+        {
+            auto &flight = flights[i];
+
+            if(flight.body_hash == key.body_hash && flight.body_len == key.body_len && flight.path == key.path && flight.method == key.method && flight.host == key.host)
+                return i;
+        }
+
+        return -1;
+    }
+
+    std::vector<Flight> flights;
+
+    Stats stats = {};
+};
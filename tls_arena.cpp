@@ -0,0 +1,202 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "mbedtls/platform.h"
+
+#include "tls_arena.hpp"
+
+#ifndef TLS_ARENA_SIZE
+#define TLS_ARENA_SIZE (64 * 1024)
+#endif
+
+// simple first-fit allocator over a list of adjacent blocks
+// mbedtls only has a few dozen live allocations at once, so walking the list is fine
+struct BlockHeader
+{
+    uint32_t size; // including header
+    uint32_t used;
+};
+
+static constexpr size_t block_align = 8;
+static constexpr size_t min_block_size = sizeof(BlockHeader) + block_align;
+
+extern "C" int __real_mbedtls_platform_set_calloc_free(void *(*calloc_func)(size_t, size_t), void (*free_func)(void *));
+
+static_assert(TLS_ARENA_SIZE % block_align == 0, "TLS_ARENA_SIZE should be a multiple of 8");
+
+alignas(block_align) static uint8_t arena[TLS_ARENA_SIZE];
+
+// whatever was installed before the arena, anything it allocated is freed through it
+static void (*prev_free)(void *) = free;
+static bool installed = false;
+
+static size_t used_bytes = 0;
+static size_t peak_bytes = 0;
+static size_t handshake_peak_bytes = 0;
+static unsigned int failed_allocs = 0;
+
+static BlockHeader *first_block()
+{
+    return reinterpret_cast<BlockHeader *>(arena);
+}
+
+static BlockHeader *next_block(BlockHeader *block)
+{
+    auto next = reinterpret_cast<uint8_t *>(block) + block->size;
+    if(next >= arena + sizeof(arena))
+        return nullptr;
+
+    return reinterpret_cast<BlockHeader *>(next);
+}
+
+static bool in_arena(void *ptr)
+{
+    auto p = static_cast<uint8_t *>(ptr);
+    return p >= arena && p < arena + sizeof(arena);
+}
+
+static void *arena_calloc(size_t n, size_t size)
+{
+    if(size && n > SIZE_MAX / size)
+    {
+        failed_allocs++;
+        return nullptr;
+    }
+
+    size_t req = (n * size + block_align - 1) & ~(block_align - 1);
+    req += sizeof(BlockHeader);
+
+    for(auto block = first_block(); block; block = next_block(block))
+    {
+        if(block->used || block->size < req)
+            continue;
+
+        // split if the remainder is big enough to be useful
+        if(block->size - req >= min_block_size)
+        {
+            auto rest = reinterpret_cast<BlockHeader *>(reinterpret_cast<uint8_t *>(block) + req);
+            rest->size = block->size - req;
+            rest->used = 0;
+            block->size = req;
+        }
+
+        block->used = 1;
+
+        used_bytes += block->size;
+        if(used_bytes > peak_bytes)
+            peak_bytes = used_bytes;
+        if(used_bytes > handshake_peak_bytes)
+            handshake_peak_bytes = used_bytes;
+
+        auto ptr = block + 1;
+        memset(ptr, 0, block->size - sizeof(BlockHeader));
+        return ptr;
+    }
+
+    failed_allocs++;
+    return nullptr;
+}
+
+static void arena_free(void *ptr)
+{
+    if(!ptr)
+        return;
+
+    // allocated before the arena was installed
+    if(!in_arena(ptr))
+    {
+        prev_free(ptr);
+        return;
+    }
+
+    auto block = static_cast<BlockHeader *>(ptr) - 1;
+    block->used = 0;
+    used_bytes -= block->size;
+
+    // merge adjacent free blocks
+    for(auto b = first_block(); b; b = next_block(b))
+    {
+        if(b->used)
+            continue;
+
+        auto next = next_block(b);
+        while(next && !next->used)
+        {
+            b->size += next->size;
+            next = next_block(b);
+        }
+    }
+}
+
+void tls_arena_init()
+{
+    // once, there may be live allocations after that (if creating the config failed and is retried)
+    if(installed)
+        return;
+
+    auto block = first_block();
+    block->size = sizeof(arena);
+    block->used = 0;
+
+    used_bytes = peak_bytes = handshake_peak_bytes = 0;
+    failed_allocs = 0;
+
+    __real_mbedtls_platform_set_calloc_free(arena_calloc, arena_free);
+    installed = true;
+}
+
+// linked with --wrap, altcp_tls_create_config installs lwIP's own allocator every time
+// that's only let through until the arena is installed, and remembered so its allocations can be freed
+extern "C" int __wrap_mbedtls_platform_set_calloc_free(void *(*calloc_func)(size_t, size_t), void (*free_func)(void *))
+{
+    if(installed)
+        return 0;
+
+    prev_free = free_func;
+
+    return __real_mbedtls_platform_set_calloc_free(calloc_func, free_func);
+}
+
+void tls_arena_reset_peak()
+{
+    handshake_peak_bytes = used_bytes;
+}
+
+TLSArenaStats tls_arena_get_stats()
+{
+    TLSArenaStats stats = {};
+    stats.size = sizeof(arena);
+    stats.used = used_bytes;
+    stats.peak = peak_bytes;
+    stats.handshake_peak = handshake_peak_bytes;
+    stats.failed_allocs = failed_allocs;
+
+    for(auto block = first_block(); block; block = next_block(block))
+    {
+        if(block->used)
+            continue;
+
+        stats.free_blocks++;
+
+        size_t usable = block->size - sizeof(BlockHeader);
+        if(usable > stats.largest_free)
+            stats.largest_free = usable;
+    }
+
+    return stats;
+}
+
+void tls_arena_print_stats(const char *label)
+{
+    auto stats = tls_arena_get_stats();
+
+    // how much of the free space can't be used for a single allocation
+    size_t free_bytes = stats.size - stats.used;
+    unsigned int fragmentation = free_bytes ? 100 - (stats.largest_free * 100) / free_bytes : 0;
+
+    printf("TLS arena (%s): used %u/%u, peak %u, handshake peak %u, %u free blocks, largest %u (%u%% fragmented), %u failed\n",
+        label, stats.used, stats.size, stats.peak, stats.handshake_peak,
+        stats.free_blocks, stats.largest_free, fragmentation, stats.failed_allocs);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+// dedicated heap for mbedtls, so TLS can't fragment or exhaust the main heap
+
+struct TLSArenaStats
+{
+    size_t size;           // total arena size
+    size_t used;           // currently allocated, including block headers
+    size_t peak;           // high-water mark since init
+    size_t handshake_peak; // high-water mark since tls_arena_reset_peak
+    size_t free_blocks;
+    size_t largest_free;   // largest single allocation that would currently succeed
+    unsigned int failed_allocs;
+};
+
+// call before creating the altcp_tls config, lwIP's own mbedtls allocator is ignored after this
+// (mbedtls_platform_set_calloc_free is wrapped at link time)
+void tls_arena_init();
+
+void tls_arena_reset_peak();
+
+TLSArenaStats tls_arena_get_stats();
+void tls_arena_print_stats(const char *label);
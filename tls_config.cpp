@@ -0,0 +1,75 @@
+#include <cstdio>
+
+#include "lwip/altcp_tls.h"
+#include "lwip/init.h"
+
+#include "mbedtls/ssl.h"
+
+#include "tls_config.hpp"
+#include "tls_arena.hpp"
+
+// the mbedtls config is the first member of lwIP's (private) altcp_tls_config, in altcp_tls_mbedtls.c
+// true for 2.1 and 2.2, check that struct again before allowing another version
+static_assert(LWIP_VERSION_MAJOR == 2 && (LWIP_VERSION_MINOR == 1 || LWIP_VERSION_MINOR == 2), "altcp_tls_config layout not checked for this lwIP version");
+
+static mbedtls_ssl_config *get_ssl_config(void *altcp_config)
+{
+    return reinterpret_cast<mbedtls_ssl_config *>(altcp_config);
+}
+
+altcp_allocator_t *TLSConfig::getAllocator()
+{
+    return &allocator;
+}
+
+bool TLSConfig::init()
+{
+    if(allocator.arg)
+        return true;
+
+    // before the config, so everything mbedtls allocates is in the arena
+    tls_arena_init();
+
+    // FIXME: cert
+    allocator.arg = altcp_tls_create_config_client(nullptr, 0);
+
+    if(!allocator.arg)
+    {
+        printf("failed to create TLS config\n");
+        return false;
+    }
+
+    apply();
+
+    return true;
+}
+
+void TLSConfig::setCipherSuites(std::initializer_list<int> suites)
+{
+    cipher_suites.assign(suites);
+    cipher_suites.push_back(0);
+
+    apply();
+}
+
+void TLSConfig::setCurves(std::initializer_list<mbedtls_ecp_group_id> curves)
+{
+    this->curves.assign(curves);
+    this->curves.push_back(MBEDTLS_ECP_DP_NONE);
+
+    apply();
+}
+
+void TLSConfig::apply()
+{
+    if(!allocator.arg)
+        return;
+
+    auto conf = get_ssl_config(allocator.arg);
+
+    if(!cipher_suites.empty())
+        mbedtls_ssl_conf_ciphersuites(conf, cipher_suites.data());
+
+    if(!curves.empty())
+        mbedtls_ssl_conf_curves(conf, curves.data());
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <initializer_list>
+#include <vector>
+
+#include "lwip/altcp_tls.h"
+
+#include "mbedtls/ecp.h"
+
+// owns the altcp_tls config passed to HTTPClient
+class TLSConfig final
+{
+public:
+    altcp_allocator_t *getAllocator();
+
+    // creates the config, needs lwIP to be initialised first
+    bool init();
+
+    // preference order, applied to any connections created after this
+    // ids are MBEDTLS_TLS_*, curves are MBEDTLS_ECP_DP_*
+    void setCipherSuites(std::initializer_list<int> suites);
+    void setCurves(std::initializer_list<mbedtls_ecp_group_id> curves);
+
+private:
+    void apply();
+
+    altcp_allocator_t allocator = {altcp_tls_alloc, nullptr};
+
+    // terminated lists, mbedtls keeps pointers to these
+    std::vector<int> cipher_suites;
+    std::vector<mbedtls_ecp_group_id> curves;
+};